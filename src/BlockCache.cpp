@@ -0,0 +1,137 @@
+#include "BlockCache.h"
+
+BlockCache::BlockCache() {
+    opened = false;
+    fileSize = 0;
+    blocks = nullptr;
+    useCounter = 0;
+    bytesRead = 0;
+    hits = 0;
+    misses = 0;
+    for (int i = 0; i < BLOCK_COUNT; i++) {
+        blockIndex[i] = -1;
+        lastUse[i] = 0;
+    }
+}
+
+BlockCache::~BlockCache() {
+    close();
+    if (blocks) {
+        free(blocks);
+        blocks = nullptr;
+    }
+}
+
+bool BlockCache::open(const String& fsPath) {
+    close();
+
+    if (!blocks) {
+        // Cache lives in PSRAM; fall back to internal RAM if unavailable
+        blocks = (uint8_t*)heap_caps_malloc(BLOCK_COUNT * BLOCK_SIZE, MALLOC_CAP_SPIRAM);
+        if (!blocks) blocks = (uint8_t*)malloc(BLOCK_COUNT * BLOCK_SIZE);
+        if (!blocks) {
+            Serial.println("BlockCache: Failed to allocate block buffer.");
+            return false;
+        }
+    }
+
+    file = LittleFS.open(fsPath, "r");
+    if (!file) {
+        Serial.printf("BlockCache: Failed to open %s\n", fsPath.c_str());
+        return false;
+    }
+
+    fileSize = file.size();
+    opened = true;
+    return true;
+}
+
+void BlockCache::close() {
+    if (opened) {
+        file.close();
+        opened = false;
+    }
+    fileSize = 0;
+    useCounter = 0;
+    bytesRead = 0;
+    hits = 0;
+    misses = 0;
+    for (int i = 0; i < BLOCK_COUNT; i++) {
+        blockIndex[i] = -1;
+        lastUse[i] = 0;
+    }
+}
+
+size_t BlockCache::readFromFile(size_t offset, uint8_t* dst, size_t n) {
+    if (!file.seek(offset)) return 0;
+    size_t got = file.read(dst, n);
+    bytesRead += got;
+    return got;
+}
+
+const uint8_t* BlockCache::getBlock(uint32_t block) {
+    int victim = 0;
+    for (int i = 0; i < BLOCK_COUNT; i++) {
+        if (blockIndex[i] == (int32_t)block) {
+            hits++;
+            lastUse[i] = ++useCounter;
+            return blocks + i * BLOCK_SIZE;
+        }
+        if (lastUse[i] < lastUse[victim]) victim = i;
+    }
+
+    // Miss: evict least recently used slot
+    misses++;
+    size_t offset = (size_t)block * BLOCK_SIZE;
+    size_t want = fileSize - offset;
+    if (want > BLOCK_SIZE) want = BLOCK_SIZE;
+
+    uint8_t* dst = blocks + victim * BLOCK_SIZE;
+    if (readFromFile(offset, dst, want) != want) {
+        blockIndex[victim] = -1;
+        lastUse[victim] = 0;
+        return nullptr;
+    }
+    blockIndex[victim] = block;
+    lastUse[victim] = ++useCounter;
+    return dst;
+}
+
+size_t BlockCache::read(uint64_t offset, void* buf, size_t n) {
+    if (!opened || offset >= fileSize) return 0;
+    if (n > fileSize - offset) n = fileSize - offset;
+
+    uint8_t* dst = (uint8_t*)buf;
+    size_t pos = (size_t)offset;
+    size_t end = pos + n;
+
+    while (pos < end) {
+        uint32_t block = pos / BLOCK_SIZE;
+        size_t blockStart = (size_t)block * BLOCK_SIZE;
+        size_t inBlock = pos - blockStart;
+        size_t chunk = BLOCK_SIZE - inBlock;
+        if (chunk > end - pos) chunk = end - pos;
+
+        if (inBlock == 0 && chunk == BLOCK_SIZE) {
+            // Whole blocks (central directory, inflate input) go straight to the caller
+            // so one big read doesn't flush the cache. Collect the run of full blocks.
+            size_t run = ((end - pos) / BLOCK_SIZE) * BLOCK_SIZE;
+            if (readFromFile(pos, dst, run) != run) break;
+            pos += run;
+            dst += run;
+            continue;
+        }
+
+        const uint8_t* src = getBlock(block);
+        if (!src) break;
+        memcpy(dst, src + inBlock, chunk);
+        pos += chunk;
+        dst += chunk;
+    }
+
+    return pos - (size_t)offset;
+}
+
+size_t BlockCache::zipRead(void* opaque, mz_uint64 offset, void* buf, size_t n) {
+    return ((BlockCache*)opaque)->read(offset, buf, n);
+}
@@ -0,0 +1,56 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "miniz.h"
+
+// Random-access reader over a LittleFS file with a small LRU cache of
+// aligned blocks. Used as the miniz m_pRead backend so an archive can be
+// opened without loading the whole file: only the central directory and
+// the entries that are actually extracted get read from flash.
+class BlockCache {
+public:
+    static const size_t BLOCK_SIZE = 4096;
+    static const int BLOCK_COUNT = 16;
+
+    BlockCache();
+    ~BlockCache();
+
+    bool open(const String& fsPath);
+    void close();
+    bool isOpen() const { return opened; }
+    size_t size() const { return fileSize; }
+    time_t getLastWrite() { return opened ? file.getLastWrite() : 0; }
+
+    // Copies n bytes at offset into buf. Returns bytes copied (short only at EOF or on error).
+    size_t read(uint64_t offset, void* buf, size_t n);
+
+    // Bytes fetched from flash since open (cache hits are not counted)
+    size_t getBytesRead() const { return bytesRead; }
+    int getHits() const { return hits; }
+    int getMisses() const { return misses; }
+
+    // mz_zip_archive::m_pRead adapter; opaque must point at a BlockCache
+    static size_t zipRead(void* opaque, mz_uint64 offset, void* buf, size_t n);
+
+private:
+    File file;
+    bool opened;
+    size_t fileSize;
+
+    uint8_t* blocks;                 // BLOCK_COUNT * BLOCK_SIZE
+    int32_t blockIndex[BLOCK_COUNT]; // file block held by each slot, -1 if empty
+    uint32_t lastUse[BLOCK_COUNT];
+    uint32_t useCounter;
+
+    size_t bytesRead;
+    int hits;
+    int misses;
+
+    size_t readFromFile(size_t offset, uint8_t* dst, size_t n);
+    // Returns the slot holding the given file block, loading it if needed (nullptr on error)
+    const uint8_t* getBlock(uint32_t block);
+};
+
+#endif
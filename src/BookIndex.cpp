@@ -0,0 +1,146 @@
+#include "BookIndex.h"
+
+namespace {
+    const uint32_t INDEX_MAGIC = 0x58505248; // "HRPX"
+    const uint16_t INDEX_VERSION = 1;
+}
+
+BookIndex::BookIndex() {
+    opened = false;
+    chapterCount = 0;
+    for (int s = 0; s < SIZE_COUNT; s++) known[s] = 0;
+}
+
+bool BookIndex::open(const String& bookPath, int chapters, int viewWidth, int viewHeight) {
+    close();
+
+    File src = LittleFS.open(bookPath, "r");
+    if (!src) return false;
+    memset(&header, 0, sizeof(header));
+    header.magic = INDEX_MAGIC;
+    header.version = INDEX_VERSION;
+    header.sizeCount = SIZE_COUNT;
+    header.sourceSize = src.size();
+    header.sourceMtime = (uint32_t)src.getLastWrite();
+    header.viewWidth = viewWidth;
+    header.viewHeight = viewHeight;
+    header.chapterCount = chapters;
+    for (int s = 0; s < SIZE_COUNT; s++) header.textSizes[s] = CompiledBook::TEXT_SIZES[s];
+    src.close();
+
+    path = indexPath(bookPath);
+    chapterCount = chapters;
+    for (int s = 0; s < SIZE_COUNT; s++) counts[s].assign(chapterCount, -1);
+
+    File f = LittleFS.open(path, "r");
+    Header existing;
+    bool valid = f && f.read((uint8_t*)&existing, sizeof(existing)) == sizeof(existing)
+        && memcmp(&existing, &header, sizeof(header)) == 0;
+    for (int s = 0; valid && s < SIZE_COUNT; s++) {
+        size_t bytes = chapterCount * sizeof(int32_t);
+        valid = f.read((uint8_t*)counts[s].data(), bytes) == bytes;
+    }
+    if (f) f.close();
+    if (!valid) {
+        for (int s = 0; s < SIZE_COUNT; s++) counts[s].assign(chapterCount, -1);
+    }
+
+    for (int s = 0; s < SIZE_COUNT; s++) {
+        known[s] = 0;
+        for (int32_t n : counts[s]) {
+            if (n >= 0) known[s]++;
+        }
+        rebuildFirstPages(s);
+    }
+
+    opened = true;
+    Serial.printf("BookIndex: %s %s (%d chapters)\n", path.c_str(), valid ? "loaded" : "started", chapterCount);
+    return true;
+}
+
+void BookIndex::close() {
+    opened = false;
+    chapterCount = 0;
+    for (int s = 0; s < SIZE_COUNT; s++) {
+        counts[s].clear();
+        firstPages[s].clear();
+        known[s] = 0;
+    }
+}
+
+bool BookIndex::save() {
+    if (!opened) return false;
+    File f = LittleFS.open(path, "w");
+    if (!f) return false;
+    bool ok = f.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+    for (int s = 0; ok && s < SIZE_COUNT; s++) {
+        size_t bytes = chapterCount * sizeof(int32_t);
+        ok = f.write((const uint8_t*)counts[s].data(), bytes) == bytes;
+    }
+    f.close();
+    // A partial file fails the size check on the next open and starts over
+    if (!ok) LittleFS.remove(path);
+    return ok;
+}
+
+int BookIndex::getPageCount(int sizeIndex, int chapter) const {
+    if (!opened || sizeIndex < 0 || sizeIndex >= SIZE_COUNT || chapter < 0 || chapter >= chapterCount) return -1;
+    return counts[sizeIndex][chapter];
+}
+
+void BookIndex::setPageCount(int sizeIndex, int chapter, int pages) {
+    if (!opened || sizeIndex < 0 || sizeIndex >= SIZE_COUNT || chapter < 0 || chapter >= chapterCount) return;
+    if (counts[sizeIndex][chapter] < 0) known[sizeIndex]++;
+    counts[sizeIndex][chapter] = pages;
+    rebuildFirstPages(sizeIndex);
+}
+
+int BookIndex::getKnownCount(int sizeIndex) const {
+    if (sizeIndex < 0 || sizeIndex >= SIZE_COUNT) return 0;
+    return known[sizeIndex];
+}
+
+bool BookIndex::isComplete(int sizeIndex) const {
+    return opened && sizeIndex >= 0 && sizeIndex < SIZE_COUNT && !firstPages[sizeIndex].empty();
+}
+
+void BookIndex::rebuildFirstPages(int sizeIndex) {
+    firstPages[sizeIndex].clear();
+    if (known[sizeIndex] < chapterCount) return;
+    firstPages[sizeIndex].resize(chapterCount + 1);
+    uint32_t total = 0;
+    for (int c = 0; c < chapterCount; c++) {
+        firstPages[sizeIndex][c] = total;
+        total += counts[sizeIndex][c];
+    }
+    firstPages[sizeIndex][chapterCount] = total;
+}
+
+int BookIndex::getTotalPages(int sizeIndex) const {
+    if (!isComplete(sizeIndex)) return 0;
+    return firstPages[sizeIndex][chapterCount];
+}
+
+int BookIndex::getFirstPage(int sizeIndex, int chapter) const {
+    if (!isComplete(sizeIndex) || chapter < 0 || chapter >= chapterCount) return 0;
+    return firstPages[sizeIndex][chapter];
+}
+
+bool BookIndex::locate(int sizeIndex, int globalPage, int& chapter, int& page) const {
+    if (!isComplete(sizeIndex) || globalPage < 0 || globalPage >= getTotalPages(sizeIndex)) return false;
+    const std::vector<uint32_t>& first = firstPages[sizeIndex];
+    // Last chapter starting at or before globalPage (empty chapters share a start)
+    int lo = 0, hi = chapterCount - 1;
+    chapter = 0;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (first[mid] <= (uint32_t)globalPage) {
+            chapter = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    page = globalPage - first[chapter];
+    return true;
+}
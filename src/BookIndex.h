@@ -0,0 +1,69 @@
+#ifndef BOOK_INDEX_H
+#define BOOK_INDEX_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <vector>
+#include "CompiledBook.h"
+
+// Page count of every chapter at each reader text size ("<book>.hpx"), for
+// book-wide page numbers. Counts are filled in as chapters get laid out and
+// saved as they go, so a partial index resumes after a reboot. Once a size
+// is complete, a global page maps to (chapter, page) without loading anything.
+//
+// File layout (little endian):
+//   Header
+//   int32 pageCount[SIZE_COUNT][chapterCount] (-1 = not laid out yet)
+class BookIndex {
+public:
+    BookIndex();
+
+    // Loads the saved index if it was built from this exact file for this
+    // viewport, otherwise starts with every count unknown
+    bool open(const String& bookPath, int chapterCount, int viewWidth, int viewHeight);
+    void close();
+    bool isOpen() const { return opened; }
+    bool save();
+
+    int getChapterCount() const { return chapterCount; }
+    // -1 while unknown
+    int getPageCount(int sizeIndex, int chapter) const;
+    void setPageCount(int sizeIndex, int chapter, int pages);
+    int getKnownCount(int sizeIndex) const;
+    bool isComplete(int sizeIndex) const;
+
+    // Book-wide numbering; only valid once the size is complete
+    int getTotalPages(int sizeIndex) const;
+    int getFirstPage(int sizeIndex, int chapter) const;
+    bool locate(int sizeIndex, int globalPage, int& chapter, int& page) const;
+
+    static String indexPath(const String& bookPath) { return bookPath + ".hpx"; }
+
+private:
+    static const int SIZE_COUNT = CompiledBook::SIZE_COUNT;
+
+    struct Header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t sizeCount;
+        uint32_t sourceSize;
+        uint32_t sourceMtime;
+        uint16_t viewWidth;
+        uint16_t viewHeight;
+        uint32_t chapterCount;
+        float textSizes[SIZE_COUNT];
+    };
+
+    String path;
+    bool opened;
+    Header header;
+    int chapterCount;
+    std::vector<int32_t> counts[SIZE_COUNT];
+    // firstPages[s][c]: pages before chapter c; chapterCount + 1 entries, empty until complete
+    std::vector<uint32_t> firstPages[SIZE_COUNT];
+    int known[SIZE_COUNT];
+
+    void rebuildFirstPages(int sizeIndex);
+};
+
+#endif
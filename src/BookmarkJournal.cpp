@@ -0,0 +1,191 @@
+#include "BookmarkJournal.h"
+#include "ZipIndex.h"
+#include "miniz.h"
+#include <algorithm>
+
+namespace {
+    const uint32_t RECORD_MAGIC = 0x4A425248; // "HRBJ"
+    const size_t READ_RECORDS = 32;
+
+    uint16_t sizeKey(float textSize) { return (uint16_t)(textSize * 100 + 0.5f); }
+}
+
+BookmarkJournal::BookmarkJournal() {
+    opened = false;
+    recordCount = 0;
+    sequence = 0;
+    bytesWritten = 0;
+}
+
+uint32_t BookmarkJournal::recordCrc(const Record& rec) {
+    return mz_crc32(MZ_CRC32_INIT, (const uint8_t*)&rec, offsetof(Record, crc));
+}
+
+BookmarkJournal::Record* BookmarkJournal::find(uint32_t bookId) {
+    auto it = std::lower_bound(live.begin(), live.end(), bookId, byBookId);
+    return it != live.end() && it->bookId == bookId ? &*it : nullptr;
+}
+
+const BookmarkJournal::Record* BookmarkJournal::find(uint32_t bookId) const {
+    auto it = std::lower_bound(live.begin(), live.end(), bookId, byBookId);
+    return it != live.end() && it->bookId == bookId ? &*it : nullptr;
+}
+
+// A newly appended record: always the newest
+void BookmarkJournal::remember(const Record& rec) {
+    auto it = std::lower_bound(live.begin(), live.end(), rec.bookId, byBookId);
+    if (it != live.end() && it->bookId == rec.bookId) *it = rec;
+    else live.insert(it, rec);
+    sequence = rec.sequence + 1;
+    touchRecent(rec.bookId);
+}
+
+void BookmarkJournal::touchRecent(uint32_t bookId) {
+    recent.erase(std::remove(recent.begin(), recent.end(), bookId), recent.end());
+    recent.insert(recent.begin(), bookId);
+    if (recent.size() > RECENT_SIZE) recent.pop_back();
+}
+
+bool BookmarkJournal::open(const String& journalPath) {
+    unsigned long startUs = micros();
+    path = journalPath;
+    live.clear();
+    recent.clear();
+    recordCount = 0;
+    sequence = 0;
+
+    // Power cut between compact()'s remove and rename: the new copy is complete
+    String tmpPath = path + ".tmp";
+    if (!LittleFS.exists(path) && LittleFS.exists(tmpPath)) LittleFS.rename(tmpPath, path);
+
+    bool torn = false;
+    File f = LittleFS.open(path, "r");
+    if (f) {
+        Record recs[READ_RECORDS];
+        while (!torn) {
+            size_t n = f.read((uint8_t*)recs, sizeof(recs));
+            for (size_t i = 0; i < n / sizeof(Record); i++) {
+                if (recs[i].magic != RECORD_MAGIC || recs[i].crc != recordCrc(recs[i])) {
+                    torn = true;
+                    break;
+                }
+                live.push_back(recs[i]);
+                recordCount++;
+            }
+            if (n % sizeof(Record) != 0) torn = true;
+            if (n < sizeof(recs)) break;
+        }
+        f.close();
+    }
+
+    // Newest record per book (later in the file means newer), then the recent list
+    std::stable_sort(live.begin(), live.end(), [](const Record& a, const Record& b) { return a.bookId < b.bookId; });
+    size_t kept = 0;
+    for (size_t i = 0; i < live.size(); i++) {
+        if (kept > 0 && live[kept - 1].bookId == live[i].bookId) live[kept - 1] = live[i];
+        else live[kept++] = live[i];
+        if (live[i].sequence >= sequence) sequence = live[i].sequence + 1;
+    }
+    live.resize(kept);
+    live.shrink_to_fit();
+    std::vector<const Record*> byAge;
+    for (const Record& rec : live) byAge.push_back(&rec);
+    size_t recentCount = std::min(byAge.size(), RECENT_SIZE);
+    std::partial_sort(byAge.begin(), byAge.begin() + recentCount, byAge.end(),
+                      [](const Record* a, const Record* b) { return a->sequence > b->sequence; });
+    for (size_t i = 0; i < recentCount; i++) recent.push_back(byAge[i]->bookId);
+
+    opened = true;
+    if (torn) {
+        Serial.printf("Bookmarks: %s has a torn tail after %d records, compacting\n", path.c_str(), recordCount);
+        compact();
+    }
+    Serial.printf("Bookmarks: %d books from %d records in %lu us\n", live.size(), recordCount, micros() - startUs);
+    return true;
+}
+
+bool BookmarkJournal::get(const String& book, Bookmark& mark) const {
+    const Record* rec = find(ZipIndex::hashName(book.c_str()));
+    if (!rec) return false;
+    mark.chapter = rec->chapter;
+    mark.page = rec->page;
+    mark.offset = rec->offset;
+    mark.textSize = rec->textSize / 100.0f;
+    return true;
+}
+
+void BookmarkJournal::getRecent(std::vector<uint32_t>& bookIds, size_t limit) const {
+    bookIds.assign(recent.begin(), recent.begin() + std::min(limit, recent.size()));
+}
+
+int BookmarkJournal::prune(bool (*keep)(uint32_t bookId)) {
+    if (!opened) return 0;
+    size_t before = live.size();
+    live.erase(std::remove_if(live.begin(), live.end(), [keep](const Record& rec) { return !keep(rec.bookId); }), live.end());
+    int dropped = before - live.size();
+    if (dropped == 0) return 0;
+
+    recent.erase(std::remove_if(recent.begin(), recent.end(), [this](uint32_t id) { return !find(id); }), recent.end());
+    Serial.printf("Bookmarks: dropping %d books no longer in the library\n", dropped);
+    compact();
+    return dropped;
+}
+
+bool BookmarkJournal::put(const String& book, const Bookmark& mark) {
+    if (!opened) return false;
+
+    Record rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.magic = RECORD_MAGIC;
+    rec.bookId = ZipIndex::hashName(book.c_str());
+    rec.chapter = mark.chapter;
+    rec.page = mark.page;
+    rec.offset = mark.offset;
+    rec.textSize = sizeKey(mark.textSize);
+
+    const Record* current = find(rec.bookId);
+    if (current && current->chapter == rec.chapter && current->page == rec.page
+        && current->offset == rec.offset && current->textSize == rec.textSize) {
+        return true;
+    }
+
+    rec.sequence = sequence;
+    rec.crc = recordCrc(rec);
+
+    File f = LittleFS.open(path, "a");
+    bool ok = f && f.write((const uint8_t*)&rec, sizeof(rec)) == sizeof(rec);
+    if (f) f.close();
+    remember(rec);
+    if (!ok) {
+        // Don't leave later appends behind a partial record
+        return compact();
+    }
+    recordCount++;
+    bytesWritten += sizeof(rec);
+
+    if (recordCount - (int)live.size() >= COMPACT_SLACK) return compact();
+    return true;
+}
+
+bool BookmarkJournal::compact() {
+    if (!opened) return false;
+    unsigned long startUs = micros();
+
+    String tmpPath = path + ".tmp";
+    File f = LittleFS.open(tmpPath, "w");
+    if (!f) return false;
+    size_t bytes = live.size() * sizeof(Record);
+    bool ok = f.write((const uint8_t*)live.data(), bytes) == bytes;
+    f.close();
+    if (!ok) {
+        LittleFS.remove(tmpPath);
+        return false;
+    }
+
+    LittleFS.remove(path);
+    if (!LittleFS.rename(tmpPath, path)) return false;
+    bytesWritten += bytes;
+    Serial.printf("Bookmarks: compacted %d records to %d in %lu us\n", recordCount, live.size(), micros() - startUs);
+    recordCount = live.size();
+    return true;
+}
@@ -0,0 +1,79 @@
+#ifndef BOOKMARK_JOURNAL_H
+#define BOOKMARK_JOURNAL_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <vector>
+
+// Reading positions of every book as an append-only journal of fixed-size
+// records ("/bookmarks.hbj"). Saving a position appends one record; the
+// newest record of a book wins. The file is rewritten with only the live
+// records once stale ones pile up, and a torn record at the end (power cut
+// mid-append) is dropped on open.
+//
+// In RAM: the newest record of each book, sorted by book id (binary search),
+// and the ids of the RECENT_SIZE most recently saved books. prune() drops
+// books no longer in the library, so both stay bounded by what is on flash.
+class BookmarkJournal {
+public:
+    struct Bookmark {
+        int chapter = 0;
+        int offset = -1;        // text offset in the chapter, -1 if only page is known
+        int page = 0;
+        float textSize = 4.0;
+    };
+
+    BookmarkJournal();
+
+    bool open(const String& journalPath);
+    bool isOpen() const { return opened; }
+
+    bool get(const String& book, Bookmark& mark) const;
+    // Appends a record unless the book's newest one already says the same
+    bool put(const String& book, const Bookmark& mark);
+    // Rewrites the journal with one record per book
+    bool compact();
+
+    static const size_t RECENT_SIZE = 50;
+    // Name hashes of the most recently saved books (up to RECENT_SIZE), newest first
+    void getRecent(std::vector<uint32_t>& bookIds, size_t limit) const;
+    // Forgets every book keep() rejects and compacts if any went. Returns the number dropped.
+    int prune(bool (*keep)(uint32_t bookId));
+
+    int getBookCount() const { return live.size(); }
+    int getRecordCount() const { return recordCount; }
+    size_t getBytesWritten() const { return bytesWritten; }
+
+private:
+    // Stale records allowed before put() compacts
+    static const int COMPACT_SLACK = 256;
+
+    struct Record {
+        uint32_t magic;
+        uint32_t bookId;        // hash of the book's file name
+        uint32_t sequence;
+        uint16_t chapter;
+        uint16_t page;
+        int32_t offset;
+        uint16_t textSize;      // x100
+        uint16_t reserved;
+        uint32_t crc;           // of the fields above
+    };
+
+    String path;
+    bool opened;
+    std::vector<Record> live;   // newest record per book, by bookId
+    std::vector<uint32_t> recent; // newest first, at most RECENT_SIZE
+    int recordCount;            // records in the file
+    uint32_t sequence;
+    size_t bytesWritten;
+
+    static uint32_t recordCrc(const Record& rec);
+    static bool byBookId(const Record& rec, uint32_t bookId) { return rec.bookId < bookId; }
+    Record* find(uint32_t bookId);
+    const Record* find(uint32_t bookId) const;
+    void remember(const Record& rec);
+    void touchRecent(uint32_t bookId);
+};
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef CANCEL_TOKEN_H
+#define CANCEL_TOKEN_H
+
+#include <Arduino.h>
+
+// Cooperative cancellation for long loads: the generation a request was
+// issued under, compared with the live counter. Long loops (inflate chunks,
+// tag stripping, page layout) poll isCancelled() and bail out early.
+// A default token never cancels.
+struct CancelToken {
+    const volatile uint32_t* current = nullptr;
+    uint32_t generation = 0;
+
+    CancelToken() {}
+    CancelToken(const volatile uint32_t& counter, uint32_t issued) : current(&counter), generation(issued) {}
+
+    bool isCancelled() const { return current && *current != generation; }
+};
+
+#endif
@@ -0,0 +1,270 @@
+#include "CompiledBook.h"
+#include "EpubReader.h"
+
+namespace {
+    const uint32_t BOOK_MAGIC = 0x4B425248; // "HRBK"
+    const uint16_t BOOK_VERSION = 5;   // 4: line tables, 5: source sizes
+    const size_t READ_CHUNK = 1024;
+}
+
+const float CompiledBook::TEXT_SIZES[CompiledBook::SIZE_COUNT] = { 3.0, 4.0, 6.0 };
+
+CompiledBook::CompiledBook() {
+    opened = false;
+}
+
+CompiledBook::~CompiledBook() {
+    close();
+}
+
+int CompiledBook::sizeIndex(float textSize) {
+    for (int i = 0; i < SIZE_COUNT; i++) {
+        if (TEXT_SIZES[i] == textSize) return i;
+    }
+    return -1;
+}
+
+bool CompiledBook::sourceIdentity(const String& bookPath, uint32_t& size, uint32_t& mtime) {
+    File src = LittleFS.open(bookPath, "r");
+    if (!src) return false;
+    size = src.size();
+    mtime = (uint32_t)src.getLastWrite();
+    src.close();
+    return true;
+}
+
+bool CompiledBook::readHeader(File& f, const String& bookPath, int viewWidth, int viewHeight, Header& header) {
+    uint32_t sourceSize, sourceMtime;
+    if (!sourceIdentity(bookPath, sourceSize, sourceMtime)) return false;
+
+    if (f.read((uint8_t*)&header, sizeof(header)) != sizeof(header)) return false;
+    if (header.magic != BOOK_MAGIC || header.version != BOOK_VERSION || header.sizeCount != SIZE_COUNT) return false;
+    if (header.sourceSize != sourceSize || header.sourceMtime != sourceMtime) return false;
+    if (header.viewWidth != viewWidth || header.viewHeight != viewHeight) return false;
+    for (int i = 0; i < SIZE_COUNT; i++) {
+        if (header.textSizes[i] != TEXT_SIZES[i]) return false;
+    }
+    return true;
+}
+
+bool CompiledBook::isCompiled(const String& bookPath, int viewWidth, int viewHeight) {
+    File f = LittleFS.open(compiledPath(bookPath), "r");
+    if (!f) return false;
+    Header header;
+    bool ok = readHeader(f, bookPath, viewWidth, viewHeight, header);
+    f.close();
+    return ok;
+}
+
+bool CompiledBook::open(const String& bookPath, int viewWidth, int viewHeight) {
+    close();
+
+    String path = compiledPath(bookPath);
+    if (!LittleFS.exists(path)) return false;
+
+    unsigned long startMs = millis();
+    file = LittleFS.open(path, "r");
+    if (!file) return false;
+
+    Header header;
+    if (!readHeader(file, bookPath, viewWidth, viewHeight, header)) {
+        Serial.printf("CompiledBook: %s is stale, ignoring\n", path.c_str());
+        file.close();
+        return false;
+    }
+
+    Footer footer;
+    size_t fileSize = file.size();
+    if (fileSize < sizeof(footer) || !file.seek(fileSize - sizeof(footer))
+        || file.read((uint8_t*)&footer, sizeof(footer)) != sizeof(footer) || footer.magic != BOOK_MAGIC) {
+        Serial.printf("CompiledBook: %s is truncated\n", path.c_str());
+        file.close();
+        return false;
+    }
+
+    chapters.resize(header.chapterCount);
+    size_t tableBytes = header.chapterCount * sizeof(ChapterRecord);
+    if (!file.seek(footer.tableOffset) || file.read((uint8_t*)chapters.data(), tableBytes) != tableBytes) {
+        chapters.clear();
+        file.close();
+        return false;
+    }
+
+    opened = true;
+    Serial.printf("CompiledBook: opened %s (%d chapters) in %lu ms\n", path.c_str(), chapters.size(), millis() - startMs);
+    return true;
+}
+
+void CompiledBook::close() {
+    if (opened) {
+        file.close();
+        opened = false;
+    }
+    chapters.clear();
+}
+
+String CompiledBook::loadChapterText(int chapter, const CancelToken& cancel) {
+    String text;
+    if (!opened || chapter < 0 || chapter >= chapters.size()) return text;
+
+    const ChapterRecord& rec = chapters[chapter];
+    if (!file.seek(rec.textOffset)) return text;
+
+    text.reserve(rec.textLength + 1);
+    char buf[READ_CHUNK];
+    uint32_t remaining = rec.textLength;
+    while (remaining > 0) {
+        if (cancel.isCancelled()) return String();
+        size_t n = remaining < READ_CHUNK ? remaining : READ_CHUNK;
+        if (file.read((uint8_t*)buf, n) != n) break;
+        text.concat(buf, n);
+        remaining -= n;
+    }
+    return text;
+}
+
+std::vector<PageInfo> CompiledBook::loadPages(int chapter, int sizeIndex, std::vector<LineInfo>& lines) {
+    std::vector<PageInfo> pages;
+    lines.clear();
+    if (!opened || chapter < 0 || chapter >= chapters.size() || sizeIndex < 0 || sizeIndex >= SIZE_COUNT) return pages;
+
+    const ChapterRecord& rec = chapters[chapter];
+    if (!file.seek(rec.pageOffset[sizeIndex])) return pages;
+
+    pages.resize(rec.pageCount[sizeIndex]);
+    for (uint32_t i = 0; i < rec.pageCount[sizeIndex]; i++) {
+        uint32_t entry[4];
+        if (file.read((uint8_t*)entry, sizeof(entry)) != sizeof(entry)) {
+            pages.resize(i);
+            break;
+        }
+        pages[i].start = entry[0];
+        pages[i].length = entry[1];
+        pages[i].firstLine = entry[2];
+        pages[i].lineCount = entry[3];
+    }
+
+    // LineInfo is stored in its in-memory layout
+    lines.resize(rec.lineCount[sizeIndex]);
+    size_t bytes = lines.size() * sizeof(LineInfo);
+    if (!file.seek(rec.lineOffset[sizeIndex]) || file.read((uint8_t*)lines.data(), bytes) != bytes) {
+        lines.clear();
+        pages.clear();
+    }
+    return pages;
+}
+
+int CompiledBook::getPageCount(int chapter, int sizeIndex) const {
+    if (!opened || chapter < 0 || chapter >= chapters.size() || sizeIndex < 0 || sizeIndex >= SIZE_COUNT) return 0;
+    return chapters[chapter].pageCount[sizeIndex];
+}
+
+std::vector<uint32_t> CompiledBook::loadParagraphs(int chapter) {
+    std::vector<uint32_t> paragraphs;
+    if (!opened || chapter < 0 || chapter >= chapters.size()) return paragraphs;
+
+    const ChapterRecord& rec = chapters[chapter];
+    if (!file.seek(rec.paraOffset)) return paragraphs;
+
+    paragraphs.resize(rec.paraCount);
+    size_t bytes = rec.paraCount * sizeof(uint32_t);
+    if (file.read((uint8_t*)paragraphs.data(), bytes) != bytes) paragraphs.clear();
+    return paragraphs;
+}
+
+bool CompiledBook::compile(const String& bookPath, int viewWidth, int viewHeight, lgfx::LovyanGFX& gfx) {
+    unsigned long startMs = millis();
+
+    uint32_t sourceSize, sourceMtime;
+    if (!sourceIdentity(bookPath, sourceSize, sourceMtime)) return false;
+
+    EpubReader source;
+    if (!source.open(bookPath.c_str())) {
+        Serial.printf("CompiledBook: cannot open %s\n", bookPath.c_str());
+        return false;
+    }
+
+    String path = compiledPath(bookPath);
+    String tmpPath = path + ".tmp";
+    File f = LittleFS.open(tmpPath, "w");
+    if (!f) return false;
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = BOOK_MAGIC;
+    header.version = BOOK_VERSION;
+    header.sizeCount = SIZE_COUNT;
+    header.sourceSize = sourceSize;
+    header.sourceMtime = sourceMtime;
+    header.viewWidth = viewWidth;
+    header.viewHeight = viewHeight;
+    header.chapterCount = source.getChapters().size();
+    for (int i = 0; i < SIZE_COUNT; i++) header.textSizes[i] = TEXT_SIZES[i];
+
+    bool ok = f.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+    std::vector<ChapterRecord> records(header.chapterCount);
+
+    for (uint32_t ch = 0; ok && ch < header.chapterCount; ch++) {
+        String text = source.getChapterContent(ch);
+        ChapterRecord& rec = records[ch];
+
+        rec.textOffset = f.position();
+        rec.textLength = text.length();
+        rec.sourceSize = source.getChapters()[ch].size;
+        ok = f.write((const uint8_t*)text.c_str(), text.length()) == text.length();
+
+        // Paragraph starts: offset 0 and every offset following a newline
+        rec.paraOffset = f.position();
+        rec.paraCount = 0;
+        for (int i = 0; ok && i < (int)text.length(); i++) {
+            if (i == 0 || text[i - 1] == '\n') {
+                uint32_t start = i;
+                ok = f.write((const uint8_t*)&start, sizeof(start)) == sizeof(start);
+                rec.paraCount++;
+            }
+        }
+
+        for (int s = 0; ok && s < SIZE_COUNT; s++) {
+            std::vector<LineInfo> lines;
+            std::vector<PageInfo> pages = Paginator::paginate(text, 0, 0, viewWidth, viewHeight, TEXT_SIZES[s], lines, gfx);
+            rec.pageOffset[s] = f.position();
+            rec.pageCount[s] = pages.size();
+            for (size_t p = 0; ok && p < pages.size(); p++) {
+                uint32_t entry[4] = { (uint32_t)pages[p].start, (uint32_t)pages[p].length,
+                                      (uint32_t)pages[p].firstLine, (uint32_t)pages[p].lineCount };
+                ok = f.write((const uint8_t*)entry, sizeof(entry)) == sizeof(entry);
+            }
+            rec.lineOffset[s] = f.position();
+            rec.lineCount[s] = lines.size();
+            size_t lineBytes = lines.size() * sizeof(LineInfo);
+            if (ok) ok = f.write((const uint8_t*)lines.data(), lineBytes) == lineBytes;
+        }
+        // Let the UI and loader tasks run between chapters
+        delay(1);
+    }
+
+    Footer footer;
+    footer.tableOffset = f.position();
+    footer.magic = BOOK_MAGIC;
+    if (ok) {
+        size_t tableBytes = records.size() * sizeof(ChapterRecord);
+        ok = f.write((const uint8_t*)records.data(), tableBytes) == tableBytes
+            && f.write((const uint8_t*)&footer, sizeof(footer)) == sizeof(footer);
+    }
+    size_t compiledSize = f.position();
+    f.close();
+    source.close();
+
+    if (!ok) {
+        Serial.printf("CompiledBook: failed writing %s\n", tmpPath.c_str());
+        LittleFS.remove(tmpPath);
+        return false;
+    }
+
+    LittleFS.remove(path);
+    if (!LittleFS.rename(tmpPath, path)) return false;
+
+    Serial.printf("CompiledBook: compiled %s -> %s (%d bytes) in %lu ms\n",
+                  bookPath.c_str(), path.c_str(), compiledSize, millis() - startMs);
+    return true;
+}
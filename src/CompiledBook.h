@@ -0,0 +1,95 @@
+#ifndef COMPILED_BOOK_H
+#define COMPILED_BOOK_H
+
+#include <Arduino.h>
+#include <M5Unified.h>
+#include <LittleFS.h>
+#include <vector>
+#include "Paginator.h"
+#include "CancelToken.h"
+
+// Pre-processed on-device copy of an EPUB ("<book>.hrb").
+// Holds the cleaned text of every spine item, its paragraph start offsets and
+// the page and line tables for each reader text size, so a page can be shown
+// with a plain file read: no unzip, no tag stripping, no layout.
+//
+// File layout (little endian):
+//   Header
+//   per chapter: text bytes | paragraph starts (uint32)
+//                | (page table (PageInfo as 4 x uint32) | line table (LineInfo)) x SIZE_COUNT
+//   ChapterRecord[chapterCount]
+//   Footer (offset of the chapter table)
+class CompiledBook {
+public:
+    static const int SIZE_COUNT = 3;
+    // Must match the sizes the reader's SIZE button cycles through
+    static const float TEXT_SIZES[SIZE_COUNT];
+
+    CompiledBook();
+    ~CompiledBook();
+
+    // Opens "<bookPath>.hrb" if it was compiled from this exact file for this viewport
+    bool open(const String& bookPath, int viewWidth, int viewHeight);
+    void close();
+    bool isOpen() const { return opened; }
+
+    int getChapterCount() const { return chapters.size(); }
+    // Uncompressed size of the chapter's XHTML in the EPUB, the scale book progress uses
+    uint32_t getChapterSourceSize(int chapter) const { return chapters[chapter].sourceSize; }
+    // Empty if cancelled part way
+    String loadChapterText(int chapter, const CancelToken& cancel = CancelToken());
+    // Page table for a size; fills lines with the matching line table
+    std::vector<PageInfo> loadPages(int chapter, int sizeIndex, std::vector<LineInfo>& lines);
+    std::vector<uint32_t> loadParagraphs(int chapter);
+    // Pages of a chapter at a size, from the chapter table (no file access)
+    int getPageCount(int chapter, int sizeIndex) const;
+
+    // Index into TEXT_SIZES, or -1 if the size isn't compiled
+    static int sizeIndex(float textSize);
+    static String compiledPath(const String& bookPath) { return bookPath + ".hrb"; }
+    static bool isCompiled(const String& bookPath, int viewWidth, int viewHeight);
+
+    // Converts bookPath into its compiled form. Slow (unzips and lays out every
+    // chapter at every size); meant for a background task. Text is measured on
+    // gfx, which should be an off-screen canvas when run off the UI task.
+    static bool compile(const String& bookPath, int viewWidth, int viewHeight, lgfx::LovyanGFX& gfx);
+
+private:
+    struct Header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t sizeCount;
+        uint32_t sourceSize;
+        uint32_t sourceMtime;
+        uint16_t viewWidth;
+        uint16_t viewHeight;
+        uint32_t chapterCount;
+        float textSizes[SIZE_COUNT];
+    };
+
+    struct ChapterRecord {
+        uint32_t textOffset;
+        uint32_t textLength;
+        uint32_t paraOffset;
+        uint32_t paraCount;
+        uint32_t pageOffset[SIZE_COUNT];
+        uint32_t pageCount[SIZE_COUNT];
+        uint32_t lineOffset[SIZE_COUNT];
+        uint32_t lineCount[SIZE_COUNT];
+        uint32_t sourceSize;
+    };
+
+    struct Footer {
+        uint32_t tableOffset;
+        uint32_t magic;
+    };
+
+    File file;
+    bool opened;
+    std::vector<ChapterRecord> chapters;
+
+    static bool sourceIdentity(const String& bookPath, uint32_t& size, uint32_t& mtime);
+    static bool readHeader(File& f, const String& bookPath, int viewWidth, int viewHeight, Header& header);
+};
+
+#endif
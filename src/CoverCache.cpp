@@ -0,0 +1,223 @@
+#include "CoverCache.h"
+#include "EpubReader.h"
+
+namespace {
+    const uint32_t CACHE_MAGIC = 0x43545248; // "HRTC"
+    const uint16_t CACHE_VERSION = 2;
+}
+
+CoverCache::CoverCache() {
+    slotCount = 0;
+    freeCount = 0;
+}
+
+size_t CoverCache::slotOffset(int slot) const {
+    return sizeof(Header) + (size_t)slot * (sizeof(Key) + THUMB_BYTES);
+}
+
+bool CoverCache::open(const String& cachePath) {
+    path = cachePath;
+    slotCount = 0;
+    freeCount = 0;
+
+    File f = LittleFS.open(path, "r");
+    if (!f) return false;
+    Header header;
+    bool valid = f.read((uint8_t*)&header, sizeof(header)) == sizeof(header)
+        && header.magic == CACHE_MAGIC && header.version == CACHE_VERSION
+        && header.width == THUMB_WIDTH && header.height == THUMB_HEIGHT
+        && f.size() >= slotOffset(header.slotCount);
+    f.close();
+    if (!valid) {
+        // Thumbnails get rebuilt; a damaged file isn't worth salvaging
+        LittleFS.remove(path);
+        return false;
+    }
+    slotCount = header.slotCount;
+    freeCount = header.freeCount;
+    return true;
+}
+
+bool CoverCache::readKey(int slot, Key& key) {
+    if (slot < 0 || slot >= slotCount) return false;
+    File f = LittleFS.open(path, "r");
+    bool ok = f && f.seek(slotOffset(slot)) && f.read((uint8_t*)&key, sizeof(Key)) == sizeof(Key);
+    if (f) f.close();
+    return ok;
+}
+
+bool CoverCache::isCurrent(int slot, uint32_t bookId, uint32_t fileSize, uint32_t fileMtime) {
+    Key key;
+    return readKey(slot, key) && !(key.flags & FLAG_FREE)
+        && key.bookId == bookId && key.fileSize == fileSize && key.fileMtime == fileMtime;
+}
+
+int CoverCache::findFreeSlot() {
+    if (freeCount == 0) return -1;
+    File f = LittleFS.open(path, "r");
+    if (!f) return -1;
+    Key key;
+    int found = -1;
+    for (int i = 0; i < slotCount && found < 0; i++) {
+        if (f.seek(slotOffset(i)) && f.read((uint8_t*)&key, sizeof(Key)) == sizeof(Key) && (key.flags & FLAG_FREE)) found = i;
+    }
+    f.close();
+    return found;
+}
+
+int CoverCache::build(const String& bookPath, int slot, uint32_t bookId, uint32_t fileSize, uint32_t fileMtime) {
+    unsigned long startMs = millis();
+    Key key;
+    memset(&key, 0, sizeof(key));
+    key.bookId = bookId;
+    key.fileSize = fileSize;
+    key.fileMtime = fileMtime;
+
+    std::vector<uint8_t> image;
+    EpubReader book;
+    bool extracted = book.open(bookPath.c_str()) && book.extractCover(image);
+    book.close();
+    unsigned long extractMs = millis() - startMs;
+
+    std::vector<uint8_t> gray(THUMB_WIDTH * THUMB_HEIGHT);
+    std::vector<uint8_t> packed(THUMB_BYTES, 0xFF);
+    unsigned long decodeStartMs = millis();
+    bool decoded = extracted && decode(image, gray.data());
+    unsigned long decodeMs = millis() - decodeStartMs;
+    if (decoded) ditherToPacked(gray.data(), packed.data());
+    else key.flags |= FLAG_NO_IMAGE;
+
+    // The book's own slot (changed file), else a released one, else a new one at the end
+    Key current;
+    bool owned = readKey(slot, current) && !(current.flags & FLAG_FREE) && current.bookId == bookId;
+    if (!owned) slot = findFreeSlot();
+    bool claimsFree = !owned && slot >= 0;
+    if (slot < 0) slot = slotCount;
+    bool ok = writeSlot(slot, key, packed.data());
+    if (ok && claimsFree) {
+        freeCount--;
+        File f = LittleFS.open(path, "r+");
+        if (f) {
+            writeHeader(f);
+            f.close();
+        }
+    }
+    Serial.printf("Covers: %s %s in %lu ms (%d KB image, extract %lu ms, decode %lu ms)\n", bookPath.c_str(),
+                  decoded ? "thumbnail" : "has no usable cover", millis() - startMs, image.size() / 1024, extractMs, decodeMs);
+    return ok ? slot : -1;
+}
+
+void CoverCache::release(int slot) {
+    Key key;
+    if (!readKey(slot, key) || (key.flags & FLAG_FREE)) return;
+    File f = LittleFS.open(path, "r+");
+    if (!f) return;
+    key.flags |= FLAG_FREE;
+    freeCount++;
+    if (f.seek(slotOffset(slot))) f.write((const uint8_t*)&key, sizeof(Key));
+    writeHeader(f);
+    f.close();
+}
+
+bool CoverCache::read(int slot, uint32_t bookId, uint8_t* pixels) {
+    if (slot < 0 || slot >= slotCount) return false;
+    File f = LittleFS.open(path, "r");
+    if (!f) return false;
+    Key key;
+    bool ok = f.seek(slotOffset(slot)) && f.read((uint8_t*)&key, sizeof(Key)) == sizeof(Key)
+        && !(key.flags & (FLAG_FREE | FLAG_NO_IMAGE)) && key.bookId == bookId
+        && f.read(pixels, THUMB_BYTES) == THUMB_BYTES;
+    f.close();
+    return ok;
+}
+
+bool CoverCache::writeHeader(File& f) {
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.width = THUMB_WIDTH;
+    header.height = THUMB_HEIGHT;
+    header.slotCount = slotCount;
+    header.freeCount = freeCount;
+    return f.seek(0) && f.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+}
+
+bool CoverCache::writeSlot(int slot, const Key& key, const uint8_t* pixels) {
+    bool created = !LittleFS.exists(path);
+    File f = LittleFS.open(path, created ? "w" : "r+");
+    if (!f) return false;
+    if (created && !writeHeader(f)) {
+        f.close();
+        return false;
+    }
+
+    // The key is written as free and only claimed once the pixels are in, so
+    // a power cut mid-write leaves the slot unclaimed
+    bool appended = slot == slotCount;
+    Key pending = key;
+    pending.flags |= FLAG_FREE;
+    bool ok = f.seek(slotOffset(slot)) && f.write((const uint8_t*)&pending, sizeof(Key)) == sizeof(Key)
+        && f.write(pixels, THUMB_BYTES) == THUMB_BYTES;
+    ok = ok && f.seek(slotOffset(slot)) && f.write((const uint8_t*)&key, sizeof(Key)) == sizeof(Key);
+    if (ok && appended) {
+        slotCount++;
+        ok = writeHeader(f);
+    }
+    f.close();
+    return ok;
+}
+
+bool CoverCache::decode(const std::vector<uint8_t>& image, uint8_t* gray) {
+    if (image.size() < 8) return false;
+    bool jpeg = image[0] == 0xFF && image[1] == 0xD8;
+    bool png = image[0] == 0x89 && image[1] == 'P' && image[2] == 'N' && image[3] == 'G';
+    if (!jpeg && !png) return false;
+
+    M5Canvas canvas;
+    canvas.setColorDepth(16);
+    canvas.setPsram(true);
+    if (!canvas.createSprite(THUMB_WIDTH, THUMB_HEIGHT)) return false;
+    canvas.fillScreen(TFT_WHITE);
+    // Scale 0: fit inside the sprite keeping the aspect ratio, centred
+    bool ok = jpeg
+        ? canvas.drawJpg(image.data(), image.size(), 0, 0, THUMB_WIDTH, THUMB_HEIGHT, 0, 0, 0.0f, 0.0f, lgfx::datum_t::middle_center)
+        : canvas.drawPng(image.data(), image.size(), 0, 0, THUMB_WIDTH, THUMB_HEIGHT, 0, 0, 0.0f, 0.0f, lgfx::datum_t::middle_center);
+    if (ok) {
+        for (int y = 0; y < THUMB_HEIGHT; y++) {
+            for (int x = 0; x < THUMB_WIDTH; x++) {
+                uint16_t c = canvas.readPixel(x, y);
+                int r = (c >> 11) * 255 / 31;
+                int g = ((c >> 5) & 0x3F) * 255 / 63;
+                int b = (c & 0x1F) * 255 / 31;
+                gray[y * THUMB_WIDTH + x] = (r * 77 + g * 150 + b * 29) >> 8;
+            }
+        }
+    }
+    canvas.deleteSprite();
+    return ok;
+}
+
+void CoverCache::ditherToPacked(const uint8_t* gray, uint8_t* packed) {
+    // Error of the current and next row, with a spare column on each side
+    std::vector<int16_t> cur(THUMB_WIDTH + 2, 0), next(THUMB_WIDTH + 2, 0);
+    for (int y = 0; y < THUMB_HEIGHT; y++) {
+        for (int x = 0; x < THUMB_WIDTH; x++) {
+            int v = gray[y * THUMB_WIDTH + x] + cur[x + 1];
+            if (v < 0) v = 0;
+            if (v > 255) v = 255;
+            int level = (v * 15 + 127) / 255;
+            int err = v - level * 17;
+            cur[x + 2] += err * 7 / 16;
+            next[x] += err * 3 / 16;
+            next[x + 1] += err * 5 / 16;
+            next[x + 2] += err / 16;
+
+            uint8_t& out = packed[(y * THUMB_WIDTH + x) / 2];
+            if (x % 2 == 0) out = level << 4;
+            else out |= level;
+        }
+        cur.swap(next);
+        std::fill(next.begin(), next.end(), 0);
+    }
+}
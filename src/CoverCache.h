@@ -0,0 +1,77 @@
+#ifndef COVER_CACHE_H
+#define COVER_CACHE_H
+
+#include <Arduino.h>
+#include <M5Unified.h>
+#include <LittleFS.h>
+#include <vector>
+
+// Cover thumbnails of every book ("/covers.htc"), decoded from the EPUB once
+// and stored already scaled and dithered to the panel's 16 grey levels as
+// packed 4bpp (two pixels a byte, left one in the high nibble, 15 = white).
+// Drawing a cover is one file read into a 4bpp sprite and a push.
+//
+// File layout (little endian): Header, then fixed-size slots of
+// Key + pixels[THUMB_BYTES]. The catalog entry of a book holds its slot
+// number, so nothing per book is kept in RAM. A slot's key (name hash, size,
+// mtime) says whose thumbnail it is; slots of changed books are rewritten in
+// place and released slots reused.
+//
+// One task writes (build, release); read() may run alongside it, since a
+// slot's key is marked free while its pixels are being written.
+class CoverCache {
+public:
+    static const int THUMB_WIDTH = 144;
+    static const int THUMB_HEIGHT = 216;
+    static const size_t THUMB_BYTES = THUMB_WIDTH * THUMB_HEIGHT / 2;
+
+    CoverCache();
+
+    // Reads only the header
+    bool open(const String& cachePath);
+    // True if slot holds this exact file's thumbnail (or its known lack of one)
+    bool isCurrent(int slot, uint32_t bookId, uint32_t fileSize, uint32_t fileMtime);
+    // Decodes the book's cover into slot if the book owns it, else into a
+    // free or new slot. Returns the slot used, -1 if it couldn't be written.
+    int build(const String& bookPath, int slot, uint32_t bookId, uint32_t fileSize, uint32_t fileMtime);
+    void release(int slot);
+
+    // Reads a book's thumbnail into a THUMB_WIDTH x THUMB_HEIGHT 4bpp sprite's buffer
+    bool read(int slot, uint32_t bookId, uint8_t* pixels);
+
+private:
+    struct Header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t width;
+        uint16_t height;
+        uint16_t reserved;
+        uint32_t slotCount;
+        uint32_t freeCount;
+    };
+    struct Key {
+        uint32_t bookId;
+        uint32_t fileSize;
+        uint32_t fileMtime;
+        uint16_t flags;
+        uint16_t reserved;
+    };
+    static const uint16_t FLAG_FREE = 1;
+    static const uint16_t FLAG_NO_IMAGE = 2; // cover couldn't be decoded; don't retry
+
+    String path;
+    int slotCount;
+    int freeCount; // released slots; build() only searches for one when there are some
+
+    size_t slotOffset(int slot) const;
+    bool readKey(int slot, Key& key);
+    int findFreeSlot();
+    bool writeSlot(int slot, const Key& key, const uint8_t* pixels);
+    bool writeHeader(File& f);
+    // JPEG/PNG scaled to fit THUMB_WIDTH x THUMB_HEIGHT, as 8-bit grey
+    static bool decode(const std::vector<uint8_t>& image, uint8_t* gray);
+    // Floyd-Steinberg from 8-bit grey down to packed 16 levels
+    static void ditherToPacked(const uint8_t* gray, uint8_t* packed);
+};
+
+#endif
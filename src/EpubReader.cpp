@@ -1,11 +1,10 @@
 #include "EpubReader.h"
 #include "HTMLParser.h"
+#include <LittleFS.h>
 
 // Define M5 and miniz logic
 EpubReader::EpubReader() {
     isOpen = false;
-    fileBuffer = nullptr;
-    memset(&zip_archive, 0, sizeof(zip_archive));
 }
 
 EpubReader::~EpubReader() {
@@ -14,96 +13,60 @@ EpubReader::~EpubReader() {
 
 void EpubReader::close() {
     if (isOpen) {
-        mz_zip_reader_end(&zip_archive);
         isOpen = false;
         chapters.clear();
+        chapterStarts.clear();
+        metadata = EpubMetadata();
         opfPath = "";
-        
-        // Free fallback buffer if used
-        if (fileBuffer) {
-            free(fileBuffer);
-            fileBuffer = nullptr;
-        }
+        coverPath = "";
     }
+    zipIndex.clear();
+    blockCache.close();
 }
 
-// Add LittleFS for fallback
-#include <LittleFS.h>
-
 bool EpubReader::open(const char* filepath) {
     if (isOpen) close();
     
     Serial.printf("EpubReader::open(%s)\n", filepath);
+    unsigned long startMs = millis();
     
-    // Initialize zip reader
-    memset(&zip_archive, 0, sizeof(zip_archive));
-    
-    // METHOD 1: Try Standard Miniz File Init (uses fopen)
-    // Note: If filepath is just /filename.epub, standard fopen might fail if VFS not mounted at root?
-    // LittleFS mount point default is /littlefs? No, M5Unified/Arduino usually mounts at /littlefs or /.
-    bool initSuccess = mz_zip_reader_init_file(&zip_archive, filepath, 0);
+    String fsPath = String(filepath);
+    // Fix path for LittleFS object
+    if (fsPath.startsWith("/littlefs")) {
+         fsPath = fsPath.substring(9); // remove /littlefs prefix (length 9)
+    }
     
-    if (!initSuccess) {
-        Serial.printf("mz_zip_reader_init_file failed for %s. Trying Memory Load Fallback...\n", filepath);
-        
-        String fsPath = String(filepath);
-        // Fix path for LittleFS object
-        if (fsPath.startsWith("/littlefs")) {
-             fsPath = fsPath.substring(9); // remove /littlefs prefix (length 9)
-        }
-        
-        if (!LittleFS.exists(fsPath)) {
-            Serial.printf("LittleFS says file does not exist: %s\n", fsPath.c_str());
-             if (fsPath.startsWith("/")) {
-                 if (LittleFS.exists(fsPath.substring(1))) {
-                     fsPath = fsPath.substring(1);
-                     Serial.printf("Found it at: %s\n", fsPath.c_str());
-                 }
+    if (!LittleFS.exists(fsPath)) {
+        Serial.printf("LittleFS says file does not exist: %s\n", fsPath.c_str());
+         if (fsPath.startsWith("/")) {
+             if (LittleFS.exists(fsPath.substring(1))) {
+                 fsPath = fsPath.substring(1);
+                 Serial.printf("Found it at: %s\n", fsPath.c_str());
              }
-        }
-        
-        File f = LittleFS.open(fsPath, "r");
-        if (!f) {
-            Serial.println("Fallback: Failed to open file with LittleFS object.");
-            return false;
-        }
-        
-        size_t size = f.size();
-        Serial.printf("File size: %d bytes\n", size);
-        
-        // Allocate buffer in PSRAM
-        fileBuffer = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
-        if (!fileBuffer) {
-            Serial.println("Fallback: Failed to allocate PSRAM buffer.");
-            f.close();
-            return false;
-        }
-        
-        // Read file
-        size_t readBytes = f.read((uint8_t*)fileBuffer, size);
-        f.close();
-        
-        if (readBytes != size) {
-            Serial.println("Fallback: Failed to read entire file.");
-            free(fileBuffer);
-            fileBuffer = nullptr;
-            return false;
-        }
-        
-        Serial.println("File loaded to PSRAM. Initializing zip from memory...");
-        initSuccess = mz_zip_reader_init_mem(&zip_archive, fileBuffer, size, 0);
-        
-        if (!initSuccess) {
-            Serial.println("mz_zip_reader_init_mem failed!");
-            free(fileBuffer);
-            fileBuffer = nullptr;
-            return false;
-        }
+         }
     }
     
-    if (!initSuccess) {
+    if (!blockCache.open(fsPath)) {
         return false;
     }
+    Serial.printf("File size: %d bytes\n", blockCache.size());
+    
+    // Sidecar index is only valid for the exact file it was built from
+    uint32_t sourceSize = blockCache.size();
+    uint32_t sourceMtime = (uint32_t)blockCache.getLastWrite();
+    String indexPath = fsPath + ".idx";
+    
+    if (zipIndex.load(indexPath, sourceSize, sourceMtime)) {
+        Serial.printf("Zip index loaded from %s (%d entries)\n", indexPath.c_str(), zipIndex.getEntryCount());
+    } else {
+        if (!buildIndex()) {
+            blockCache.close();
+            return false;
+        }
+        if (!zipIndex.save(indexPath, sourceSize, sourceMtime)) {
+            Serial.printf("Warning: could not write zip index %s\n", indexPath.c_str());
+        }
+    }
     
     Serial.println("Zip Initialized Successfully.");
     isOpen = true;
@@ -119,33 +82,201 @@ bool EpubReader::open(const char* filepath) {
         Serial.println("Failed to parse OPF");
         return false;
     }
+    measureChapters();
     
-    Serial.println("Book Opened Successfully.");
+    Serial.printf("Book Opened Successfully in %lu ms. Read %d of %d bytes (%d block hits, %d misses)\n",
+                  millis() - startMs, blockCache.getBytesRead(), blockCache.size(), blockCache.getHits(), blockCache.getMisses());
     return true;
 }
 
+bool EpubReader::buildIndex() {
+    // Parse the central directory once with miniz (on top of the block cache),
+    // keep only the compact index and release miniz's copy.
+    mz_zip_archive zip_archive;
+    memset(&zip_archive, 0, sizeof(zip_archive));
+    zip_archive.m_pRead = BlockCache::zipRead;
+    zip_archive.m_pIO_opaque = &blockCache;
+    
+    if (!mz_zip_reader_init(&zip_archive, blockCache.size(), 0)) {
+        Serial.println("mz_zip_reader_init failed!");
+        return false;
+    }
+    
+    bool ok = zipIndex.build(&zip_archive);
+    mz_zip_reader_end(&zip_archive);
+    
+    if (!ok) {
+        Serial.println("Failed to build zip index!");
+        return false;
+    }
+    Serial.printf("Zip index built (%d entries)\n", zipIndex.getEntryCount());
+    return true;
+}
+
+const ZipIndexEntry* EpubReader::locateFile(const char* filename, uint32_t& dataOffset) {
+    if (!isOpen) return nullptr;
+    
+    const ZipIndexEntry* entry = zipIndex.locate(filename, blockCache, dataOffset);
+    if (!entry) {
+        Serial.printf("Failed to locate file: %s\n", filename);
+    }
+    return entry;
+}
+
+bool EpubReader::extractEntry(const ZipIndexEntry* entry, uint32_t dataOffset, ChunkSink sink, void* ctx) {
+    if (entry->method != 0 && entry->method != MZ_DEFLATED) {
+        Serial.printf("Unsupported compression method %d\n", entry->method);
+        return false;
+    }
+    
+    // Fixed-size input chunk; deflate also needs the 32 KB window and the inflater state
+    uint8_t* inBuf = (uint8_t*)malloc(STREAM_CHUNK_SIZE);
+    uint8_t* dict = nullptr;
+    tinfl_decompressor* inflator = nullptr;
+    if (entry->method == MZ_DEFLATED) {
+        dict = (uint8_t*)heap_caps_malloc(TINFL_LZ_DICT_SIZE, MALLOC_CAP_SPIRAM);
+        if (!dict) dict = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+        inflator = (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor));
+    }
+    if (!inBuf || (entry->method == MZ_DEFLATED && (!dict || !inflator))) {
+        Serial.println("Failed to allocate extraction buffers");
+        free(inBuf);
+        free(dict);
+        free(inflator);
+        return false;
+    }
+    
+    bool ok = true;
+    uint32_t crc = MZ_CRC32_INIT;
+    size_t produced = 0;
+    size_t compRemaining = entry->compSize;
+    size_t readOffset = dataOffset;
+    
+    if (entry->method == 0) {
+        // Stored: copy through in chunks
+        while (ok && compRemaining > 0) {
+            size_t n = compRemaining < STREAM_CHUNK_SIZE ? compRemaining : STREAM_CHUNK_SIZE;
+            if (blockCache.read(readOffset, inBuf, n) != n) { ok = false; break; }
+            readOffset += n;
+            compRemaining -= n;
+            crc = mz_crc32(crc, inBuf, n);
+            produced += n;
+            ok = sink(ctx, (const char*)inBuf, n);
+        }
+    } else {
+        tinfl_init(inflator);
+        size_t inPos = 0;
+        size_t inAvail = 0;
+        size_t dictOfs = 0;
+        
+        while (ok) {
+            if (inPos == inAvail && compRemaining > 0) {
+                size_t n = compRemaining < STREAM_CHUNK_SIZE ? compRemaining : STREAM_CHUNK_SIZE;
+                if (blockCache.read(readOffset, inBuf, n) != n) { ok = false; break; }
+                readOffset += n;
+                compRemaining -= n;
+                inPos = 0;
+                inAvail = n;
+            }
+            
+            size_t inBytes = inAvail - inPos;
+            size_t outBytes = TINFL_LZ_DICT_SIZE - dictOfs;
+            tinfl_status status = tinfl_decompress(inflator, inBuf + inPos, &inBytes, dict, dict + dictOfs, &outBytes,
+                                                   compRemaining > 0 ? TINFL_FLAG_HAS_MORE_INPUT : 0);
+            inPos += inBytes;
+            
+            if (outBytes > 0) {
+                crc = mz_crc32(crc, dict + dictOfs, outBytes);
+                produced += outBytes;
+                ok = sink(ctx, (const char*)(dict + dictOfs), outBytes);
+                dictOfs = (dictOfs + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+            }
+            
+            if (status == TINFL_STATUS_DONE) break;
+            if (status < 0 || (status == TINFL_STATUS_NEEDS_MORE_INPUT && compRemaining == 0 && inPos == inAvail)) {
+                ok = false;
+            }
+        }
+    }
+    
+    free(inBuf);
+    free(dict);
+    free(inflator);
+    
+    if (ok && (produced != entry->uncompSize || crc != entry->crc32)) {
+        Serial.println("Extraction failed (size/CRC mismatch)");
+        ok = false;
+    }
+    return ok;
+}
+
+static bool appendToString(void* ctx, const char* data, size_t len) {
+    return ((String*)ctx)->concat(data, len);
+}
+
 String EpubReader::extractFileToString(const char* filename) {
-    if (!isOpen) return "";
+    uint32_t dataOffset = 0;
+    const ZipIndexEntry* entry = locateFile(filename, dataOffset);
+    if (!entry) return "";
     
-    size_t file_size;
-    void* p = mz_zip_reader_extract_file_to_heap(&zip_archive, filename, &file_size, 0);
-    if (!p) {
+    String content;
+    content.reserve(entry->uncompSize + 1);
+    if (!extractEntry(entry, dataOffset, appendToString, &content)) {
         Serial.printf("Failed to extract file: %s\n", filename);
         return "";
     }
+    return content;
+}
+
+static bool appendToBytes(void* ctx, const char* data, size_t len) {
+    std::vector<uint8_t>* bytes = (std::vector<uint8_t>*)ctx;
+    bytes->insert(bytes->end(), (const uint8_t*)data, (const uint8_t*)data + len);
+    return true;
+}
+
+bool EpubReader::extractCover(std::vector<uint8_t>& data) {
+    data.clear();
+    if (!isOpen || coverPath.length() == 0) return false;
+    uint32_t dataOffset = 0;
+    const ZipIndexEntry* entry = locateFile(coverPath.c_str(), dataOffset);
+    if (!entry) {
+        Serial.printf("Cover %s not in archive\n", coverPath.c_str());
+        return false;
+    }
+    data.reserve(entry->uncompSize);
+    return extractEntry(entry, dataOffset, appendToBytes, &data);
+}
+
+struct StripperSink {
+    HTMLStripper* stripper;
+    const CancelToken* cancel;
+};
+
+static bool feedStripper(void* ctx, const char* data, size_t len) {
+    StripperSink* sink = (StripperSink*)ctx;
+    // Returning false stops the inflate loop before the next chunk
+    if (sink->cancel->isCancelled()) return false;
+    sink->stripper->feed(data, len);
+    return true;
+}
+
+bool EpubReader::streamFileToStripper(const char* filename, HTMLStripper& stripper, size_t& rawSize, const CancelToken& cancel) {
+    rawSize = 0;
+    uint32_t dataOffset = 0;
+    const ZipIndexEntry* entry = locateFile(filename, dataOffset);
+    if (!entry) return false;
     
-    // Create string (assuming null termination might be missing, so use size)
-    String content = String((char*)p);
-    // Warning: String(char*, length) constructor might not behave as expected if not null terminated in older cores,
-    // but usually constructor String(char*) relies on null terminator.
-    // miniz does not guarantee null terminator.
-    // Safer:
-    String safeContent;
-    safeContent.reserve(file_size + 1);
-    for(size_t i=0; i<file_size; i++) safeContent += ((char*)p)[i];
-    
-    mz_free(p);
-    return safeContent;
+    // Only one input chunk and the inflate window are held at once; the stripper keeps just
+    // the text, in a buffer allocated once at the XHTML size
+    stripper.reserve(entry->uncompSize);
+    StripperSink sink = { &stripper, &cancel };
+    if (!extractEntry(entry, dataOffset, feedStripper, &sink)) {
+        if (cancel.isCancelled()) return false;
+        Serial.printf("Failed to extract file: %s\n", filename);
+        return false;
+    }
+    rawSize = entry->uncompSize;
+    return true;
 }
 
 bool EpubReader::parseContainer() {
@@ -183,9 +314,12 @@ bool EpubReader::parseOPF() {
     
     tinyxml2::XMLElement* package = doc.RootElement();
     if (!package) return false;
+    String coverId;
+    parseMetadata(package, coverId);
     
     // 1. Map Manifest (id -> href)
     std::vector<std::pair<String, String>> manifest;
+    String coverHref;
     tinyxml2::XMLElement* manifestEl = package->FirstChildElement("manifest");
     if (manifestEl) {
         for (tinyxml2::XMLElement* item = manifestEl->FirstChildElement("item"); item; item = item->NextSiblingElement("item")) {
@@ -193,6 +327,10 @@ bool EpubReader::parseOPF() {
             const char* href = item->Attribute("href");
             if (id && href) {
                 manifest.push_back({String(id), String(href)});
+                // EPUB 3 marks the cover in the manifest; EPUB 2 names its id in <metadata>
+                const char* properties = item->Attribute("properties");
+                if (properties && strstr(properties, "cover-image")) coverHref = String(href);
+                else if (coverHref.length() == 0 && coverId == id) coverHref = String(href);
             }
         }
     }
@@ -207,6 +345,7 @@ bool EpubReader::parseOPF() {
     if (lastSlash != -1) {
         basePath = opfPath.substring(0, lastSlash + 1);
     }
+    if (coverHref.length() > 0) coverPath = basePath + coverHref;
     
     for (tinyxml2::XMLElement* itemref = spineEl->FirstChildElement("itemref"); itemref; itemref = itemref->NextSiblingElement("itemref")) {
         const char* idref = itemref->Attribute("idref");
@@ -235,18 +374,78 @@ bool EpubReader::parseOPF() {
     return chapters.size() > 0;
 }
 
-String EpubReader::getChapterContent(int index) {
+void EpubReader::parseMetadata(tinyxml2::XMLElement* package, String& coverId) {
+    tinyxml2::XMLElement* metadataEl = package->FirstChildElement("metadata");
+    if (!metadataEl) return;
+    
+    const char* uniqueId = package->Attribute("unique-identifier");
+    for (tinyxml2::XMLElement* el = metadataEl->FirstChildElement(); el; el = el->NextSiblingElement()) {
+        const char* name = el->Name();
+        if (strcmp(name, "meta") == 0 && el->Attribute("name", "cover") && el->Attribute("content")) {
+            coverId = String(el->Attribute("content"));
+            continue;
+        }
+        const char* text = el->GetText();
+        if (!text) continue;
+        if (strcmp(name, "dc:title") == 0 && metadata.title.length() == 0) {
+            metadata.title = String(text);
+        } else if (strcmp(name, "dc:creator") == 0 && metadata.author.length() == 0) {
+            metadata.author = String(text);
+        } else if (strcmp(name, "dc:language") == 0 && metadata.language.length() == 0) {
+            metadata.language = String(text);
+        } else if (strcmp(name, "dc:identifier") == 0) {
+            const char* id = el->Attribute("id");
+            bool isUnique = uniqueId && id && strcmp(id, uniqueId) == 0;
+            if (isUnique || metadata.identifier.length() == 0) metadata.identifier = String(text);
+        }
+    }
+    metadata.title.trim();
+    metadata.author.trim();
+    metadata.language.trim();
+    metadata.identifier.trim();
+}
+
+void EpubReader::measureChapters() {
+    unsigned long startUs = micros();
+    chapterStarts.resize(chapters.size() + 1);
+    uint32_t total = 0;
+    for (size_t i = 0; i < chapters.size(); i++) {
+        uint32_t dataOffset;
+        const ZipIndexEntry* entry = locateFile(chapters[i].filename.c_str(), dataOffset);
+        chapters[i].size = entry ? entry->uncompSize : 0;
+        chapterStarts[i] = total;
+        total += chapters[i].size;
+    }
+    chapterStarts[chapters.size()] = total;
+    Serial.printf("Chapter sizes: %d bytes uncompressed in %d chapters (%lu us)\n", total, chapters.size(), micros() - startUs);
+}
+
+String EpubReader::getChapterContent(int index, const CancelToken& cancel) {
     if (index < 0 || index >= chapters.size()) return "";
     
-    String rawHtml = extractFileToString(chapters[index].filename.c_str());
-    if (rawHtml.length() == 0) {
+    unsigned long startUs = micros();
+    HTMLStripper stripper;
+    size_t rawSize = 0;
+    bool ok = streamFileToStripper(chapters[index].filename.c_str(), stripper, rawSize, cancel);
+    if (cancel.isCancelled()) {
+        Serial.printf("Chapter %d cancelled after %lu us\n", index, micros() - startUs);
+        return "";
+    }
+    if (!ok || rawSize == 0) {
         Serial.printf("Error: Raw content empty for %s\n", chapters[index].filename.c_str());
         return "Error reading chapter.";
     }
     
-    Serial.printf("Raw HTML Size: %d bytes\n", rawHtml.length());
-    String cleanContent = HTMLParser::stripTags(rawHtml);
+    String cleanContent = stripper.finish();
+    unsigned long elapsedUs = micros() - startUs;
+    
+    // The raw XHTML is never held: only the fixed chunk/inflate buffers and
+    // the text buffer, reserved once at the XHTML size
+    size_t inflateBytes = STREAM_CHUNK_SIZE + TINFL_LZ_DICT_SIZE + sizeof(tinfl_decompressor);
+    Serial.printf("Raw HTML Size: %d bytes\n", rawSize);
     Serial.printf("Clean Text Size: %d bytes\n", cleanContent.length());
+    Serial.printf("Stream: %lu us, %.2f MB/s, text buffer peak %d bytes + %d inflate buffers\n", elapsedUs,
+                  elapsedUs ? (rawSize / (float)elapsedUs) : 0.0f, stripper.peakBufferBytes(), inflateBytes);
     
     return cleanContent;
 }
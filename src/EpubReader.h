@@ -5,31 +5,69 @@
 #include <vector>
 #include "miniz.h"
 #include <tinyxml2.h>
+#include "BlockCache.h"
+#include "ZipIndex.h"
+#include "CancelToken.h"
+
+class HTMLStripper;
 
 struct EpubChapter {
     String title;
     String filename; // internal path in zip
     String id;
+    uint32_t size = 0; // uncompressed bytes, from the zip central directory
+};
+
+// Dublin Core fields from the OPF <metadata>; empty when the book has none
+struct EpubMetadata {
+    String title;
+    String author;      // first dc:creator
+    String language;
+    String identifier;  // the package's unique-identifier, else the first dc:identifier
 };
 
 class EpubReader {
 private:
-    mz_zip_archive zip_archive;
     bool isOpen;
     std::vector<EpubChapter> chapters;
-    // File Buffer for memory loading fallback
-    void* fileBuffer = nullptr;
+    EpubMetadata metadata;
+    // chapterStarts[i]: uncompressed bytes before chapter i (chapters.size() + 1 entries)
+    std::vector<uint32_t> chapterStarts;
+    // Random-access backend for the zip (LRU of file blocks)
+    BlockCache blockCache;
+    // Central directory index (loaded from / saved to "<book>.idx")
+    ZipIndex zipIndex;
     String opfPath;
+    String coverPath; // zip path of the cover image, empty if the OPF names none
 
+    // Receives decompressed data in order; return false to abort extraction
+    typedef bool (*ChunkSink)(void* ctx, const char* data, size_t len);
+    
+    // Parse the central directory with miniz and build zipIndex from it
+    bool buildIndex();
+    // Resolve an entry through zipIndex
+    const ZipIndexEntry* locateFile(const char* filename, uint32_t& dataOffset);
+    // Inflate (or copy, if stored) an entry in fixed-size chunks into sink
+    bool extractEntry(const ZipIndexEntry* entry, uint32_t dataOffset, ChunkSink sink, void* ctx);
     // Helper to extract a file from zip to String
     String extractFileToString(const char* filename);
+    // Inflate a file from zip in fixed-size chunks straight into the tag stripper.
+    // cancel is checked between chunks.
+    bool streamFileToStripper(const char* filename, HTMLStripper& stripper, size_t& rawSize, const CancelToken& cancel);
     
     // Parse container.xml to find OPF
     bool parseContainer();
     // Parse OPF to get metadata and spine
     bool parseOPF();
+    // coverId: the EPUB 2 <meta name="cover"> manifest id, if any
+    void parseMetadata(tinyxml2::XMLElement* package, String& coverId);
+    // Fill chapter sizes and chapterStarts from the zip index (no inflating)
+    void measureChapters();
 
 public:
+    // Size of each decompressed chunk handed to the tag stripper
+    static const size_t STREAM_CHUNK_SIZE = 4096;
+
     EpubReader();
     ~EpubReader();
 
@@ -38,9 +76,18 @@ public:
     
     // Get list of chapters (spine)
     const std::vector<EpubChapter>& getChapters() { return chapters; }
+    const EpubMetadata& getMetadata() const { return metadata; }
+    bool hasCover() const { return coverPath.length() > 0; }
+    // Raw bytes of the cover image (JPEG or PNG as stored in the book)
+    bool extractCover(std::vector<uint8_t>& data);
+    // Cumulative uncompressed sizes: a cheap book-progress scale before any layout exists
+    const std::vector<uint32_t>& getChapterStarts() const { return chapterStarts; }
+    
+    // Extract text content of a chapter; empty if cancelled part way
+    String getChapterContent(int index, const CancelToken& cancel = CancelToken());
     
-    // Extract text content of a chapter
-    String getChapterContent(int index);
+    // Bytes read from flash since open() (central directory + extracted entries)
+    size_t getBytesRead() const { return blockCache.getBytesRead(); }
 };
 
 #endif
@@ -0,0 +1,130 @@
+#include "FontMetrics.h"
+
+FontMetrics FontMetrics::cache[FontMetrics::CACHE_SIZE];
+volatile int FontMetrics::cacheCount = 0;
+SemaphoreHandle_t FontMetrics::buildMutex = NULL;
+
+FontMetrics::FontMetrics() {
+    font = nullptr;
+    size = 0;
+    spaceWidth = 0;
+    lineHeight = 0;
+    otherAdvance = 0;
+    otherExtent = 0;
+}
+
+namespace {
+    int encodeUTF8(uint32_t cp, char* buf) {
+        if (cp < 0x80) {
+            buf[0] = cp;
+            return 1;
+        }
+        if (cp < 0x800) {
+            buf[0] = 0xC0 | (cp >> 6);
+            buf[1] = 0x80 | (cp & 0x3F);
+            return 2;
+        }
+        buf[0] = 0xE0 | (cp >> 12);
+        buf[1] = 0x80 | ((cp >> 6) & 0x3F);
+        buf[2] = 0x80 | (cp & 0x3F);
+        return 3;
+    }
+
+    // Width of one glyph alone and of the glyph followed by a space:
+    // the difference is its advance, the former its extent at the end of a string
+    void measureGlyph(lgfx::LovyanGFX& gfx, uint32_t cp, int spaceWidth, uint16_t& advance, uint16_t& extent) {
+        char buf[8];
+        int n = encodeUTF8(cp, buf);
+        buf[n] = 0;
+        extent = gfx.textWidth(buf);
+        buf[n] = ' ';
+        buf[n + 1] = 0;
+        int withSpace = gfx.textWidth(buf);
+        advance = withSpace > 0 ? withSpace - spaceWidth : 0;
+    }
+}
+
+void FontMetrics::build(lgfx::LovyanGFX& gfx, float textSize) {
+    gfx.setTextSize(textSize);
+    font = gfx.getFont();
+    size = textSize;
+    spaceWidth = gfx.textWidth(" ");
+    lineHeight = gfx.fontHeight();
+
+    for (int cp = 0; cp < 256; cp++) {
+        measureGlyph(gfx, cp, spaceWidth, advance[cp], extent[cp]);
+    }
+    // NUL can't be measured through a C string; it never appears in chapter text
+    advance[0] = extent[0] = 0;
+    // Code points beyond Latin-1 all measure the same in the bitmap fonts
+    measureGlyph(gfx, 0x2192, spaceWidth, otherAdvance, otherExtent);
+}
+
+int FontMetrics::textWidth(const char* text, int len) const {
+    int width = 0;
+    int last = 0;
+    int i = 0;
+    while (i < len) {
+        unsigned char c = text[i];
+        uint32_t cp = c;
+        int n = 1;
+        // Decode UTF-8 the way the renderer does before looking up the glyph
+        if (c >= 0xC0) {
+            n = c >= 0xF0 ? 4 : (c >= 0xE0 ? 3 : 2);
+            cp = c & (0x7F >> n);
+            for (int k = 1; k < n && i + k < len; k++) cp = (cp << 6) | ((unsigned char)text[i + k] & 0x3F);
+        } else if (c >= 0x80) {
+            // Stray continuation byte
+            i++;
+            continue;
+        }
+        int adv = cp < 256 ? advance[cp] : otherAdvance;
+        last = cp < 256 ? extent[cp] - adv : otherExtent - otherAdvance;
+        width += adv;
+        i += n;
+    }
+    return width + last;
+}
+
+const FontMetrics* FontMetrics::find(const lgfx::IFont* font, float textSize) {
+    int count = cacheCount;
+    for (int i = 0; i < count; i++) {
+        if (cache[i].font == font && cache[i].size == textSize) return &cache[i];
+    }
+    return nullptr;
+}
+
+const FontMetrics& FontMetrics::get(lgfx::LovyanGFX& gfx, float textSize) {
+    const lgfx::IFont* current = gfx.getFont();
+    const FontMetrics* found = find(current, textSize);
+    if (found) return *found;
+
+    // Not prepared: build on a private canvas so gfx's text state is left alone
+    xSemaphoreTake(buildMutex, portMAX_DELAY);
+    found = find(current, textSize);
+    if (!found && cacheCount < CACHE_SIZE) {
+        unsigned long startUs = micros();
+        M5Canvas measure(&gfx);
+        measure.setFont(current);
+        cache[cacheCount].build(measure, textSize);
+        found = &cache[cacheCount];
+        // Published only once complete; slots are never rebuilt
+        cacheCount = cacheCount + 1;
+        Serial.printf("FontMetrics: built size %.1f in %lu us\n", textSize, micros() - startUs);
+    }
+    if (!found) {
+        // Full: the nearest size of the same font (the layout may run a little off)
+        Serial.printf("FontMetrics: no room for size %.1f\n", textSize);
+        for (int i = 0; i < cacheCount; i++) {
+            if (cache[i].font == current && (!found || fabsf(cache[i].size - textSize) < fabsf(found->size - textSize))) found = &cache[i];
+        }
+        if (!found) found = &cache[0];
+    }
+    xSemaphoreGive(buildMutex);
+    return *found;
+}
+
+void FontMetrics::prepare(lgfx::LovyanGFX& gfx, const float* sizes, int count) {
+    if (!buildMutex) buildMutex = xSemaphoreCreateMutex();
+    for (int i = 0; i < count; i++) get(gfx, sizes[i]);
+}
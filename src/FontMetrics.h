@@ -0,0 +1,53 @@
+#ifndef FONT_METRICS_H
+#define FONT_METRICS_H
+
+#include <Arduino.h>
+#include <M5Unified.h>
+
+// Advance-width table for one font at one text size, measured once through
+// the renderer so layout can sum widths straight over the text buffer
+// without building Strings or walking the font per word.
+//
+// Widths come out identical to gfx.textWidth() for fonts whose glyphs don't
+// hang left of their origin (true for the built-in bitmap fonts).
+class FontMetrics {
+public:
+    FontMetrics();
+
+    // Measures gfx's current font at textSize. Leaves gfx's text size changed.
+    void build(lgfx::LovyanGFX& gfx, float textSize);
+
+    // Same result as gfx.textWidth() on text[0..len)
+    int textWidth(const char* text, int len) const;
+    int getSpaceWidth() const { return spaceWidth; }
+    int getLineHeight() const { return lineHeight; }
+
+    // Table for gfx's current font at textSize. A lookup once built; a miss
+    // builds on a private canvas under a lock, so gfx isn't touched and any
+    // task may call it. Tables stay put once built (references remain valid).
+    static const FontMetrics& get(lgfx::LovyanGFX& gfx, float textSize);
+    // Builds the sizes in use. Call from setup, before any task lays out text.
+    static void prepare(lgfx::LovyanGFX& gfx, const float* sizes, int count);
+
+private:
+    static const int CACHE_SIZE = 8;
+
+    const lgfx::IFont* font;
+    float size;
+    int spaceWidth;
+    int lineHeight;
+    // Indexed by code point (< 256); everything above shares otherAdvance
+    uint16_t advance[256];
+    // Width a glyph adds when it ends the string (may exceed its advance)
+    uint16_t extent[256];
+    uint16_t otherAdvance;
+    uint16_t otherExtent;
+
+    static FontMetrics cache[CACHE_SIZE];
+    static volatile int cacheCount;   // slots below are complete and read without the lock
+    static SemaphoreHandle_t buildMutex;
+
+    static const FontMetrics* find(const lgfx::IFont* font, float textSize);
+};
+
+#endif
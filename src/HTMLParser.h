@@ -2,122 +2,416 @@
 #define HTML_PARSER_H
 
 #include <Arduino.h>
+#include <utility>
+#include "HTMLEntities.h"
 
 class HTMLParser {
 public:
-    static String stripTags(const String& html) {
-        String script = "";
-        bool insideTag = false;
-        bool ignoreContent = false; 
-        
-        script.reserve(html.length());
-        
-        for (int i = 0; i < html.length(); i++) {
-            char c = html[i];
-            
-            if (c == '<') {
-                insideTag = true;
-                
-                // Check for start of style or script to enable ignore mode
-                if (html.substring(i, i+6).equalsIgnoreCase("<style")) ignoreContent = true;
-                if (html.substring(i, i+7).equalsIgnoreCase("<script")) ignoreContent = true;
-                if (html.substring(i, i+5).equalsIgnoreCase("<head")) ignoreContent = true;
-                
-                // Block tags that imply newlines
-                if (html.substring(i, i+3).equalsIgnoreCase("<p>") || 
-                    html.substring(i, i+3).equalsIgnoreCase("<p ") ||
-                    html.substring(i, i+4).equalsIgnoreCase("<div") ||
-                    html.substring(i, i+4).equalsIgnoreCase("<br")) {
-                    if (script.length() > 0 && script[script.length()-1] != '\n') script += '\n';
-                }
+    // Strips a complete in-memory document (see HTMLStripper for the streaming form)
+    static String stripTags(const String& html);
+};
+
+// Single-pass XHTML to plain text tokenizer.
+// Raw XHTML can be fed in arbitrarily sized chunks (e.g. straight out of the
+// zip inflater). Tags, style/script/head skipping, entities, typographic
+// punctuation and whitespace are all handled in one linear scan; the only
+// allocation is the output buffer. Call finish() to take the result.
+//
+// Output rules the Paginator relies on:
+//  - block tags (p, div, br, h1-h6, li, blockquote) start a new line
+//  - a whitespace run becomes one space, or one or two newlines if it
+//    contains line breaks (never more than one blank line)
+class HTMLStripper {
+public:
+    HTMLStripper() {}
+
+    void feed(const char* data, size_t len) {
+        for (size_t i = 0; i < len; i++) {
+            char c = data[i];
+            switch (state) {
+                case TEXT:      onText(c); break;
+                case TAG_OPEN:  onTagOpen(c); break;
+                case TAG_NAME:  onTagName(c); break;
+                case TAG_ATTRS: onTagAttrs(c); break;
+                case COMMENT:   onComment(c); break;
+                case DECL:      if (c == '>') state = TEXT; break;
+                case ENTITY:    onEntity(c); break;
+            }
+        }
+    }
+
+    // Flushes pending state and returns the text
+    String finish() {
+        if (state == ENTITY) flushRawEntity();
+        if (utf8Len > 0) emitText(utf8Buf, utf8Len);
+        utf8Len = 0;
+        state = TEXT;
+        flushWhitespace();
+        flush();
+        reserved = 0;
+        return std::move(out);
+    }
+
+    // Sizes the output buffer up front, e.g. to the raw XHTML length: text
+    // never gets much longer than its markup, so the buffer is allocated once
+    // instead of grown (and copied) as text arrives
+    void reserve(size_t bytes) {
+        if (bytes <= reserved || !out.reserve(bytes)) return;
+        reserved = bytes;
+        if (reserved > peakBuffer) peakBuffer = reserved;
+    }
+
+    // Bytes of clean text produced so far
+    size_t outputLength() const { return out.length() + pendingLen; }
+    // Most bytes the output buffer has held at once, counting the old
+    // buffer a grow copies from
+    size_t peakBufferBytes() const { return peakBuffer; }
+
+private:
+    enum State { TEXT, TAG_OPEN, TAG_NAME, TAG_ATTRS, COMMENT, DECL, ENTITY };
+
+    static const int PENDING_SIZE = 128;
+    static const int MAX_TAG_NAME = 10;   // "blockquote"; longer names never match
+    static const int MAX_ENTITY = HTML_ENTITY_MAX_NAME + 1;
+
+    State state = TEXT;
+
+    String out;
+    size_t reserved = 0;
+    size_t peakBuffer = 0;
+    char pending[PENDING_SIZE];
+    int pendingLen = 0;
+
+    // Whitespace seen since the last visible character
+    bool runSpace = false;
+    int runNewlines = 0;
+    bool anyText = false;         // anything (even a space) emitted yet
+    bool afterBreak = false;      // nothing emitted since the last block break
+
+    char tagName[MAX_TAG_NAME];
+    int tagNameLen = 0;           // > MAX_TAG_NAME once the name overflows
+    bool tagClosing = false;
+    bool tagSelfClosing = false;
+    char quote = 0;
+    int commentDashes = 0;
+
+    // Set inside <style>/<script>/<head> until the matching close tag
+    const char* skipUntil = nullptr;
+
+    char entityBuf[MAX_ENTITY];
+    int entityLen = 0;
+    char utf8Buf[4];
+    int utf8Len = 0;
+    int utf8Need = 0;
+
+    void flush() {
+        if (pendingLen == 0) return;
+        size_t needed = out.length() + pendingLen;
+        if (needed > reserved) {
+            // Past the reserve (or without one): grow geometrically, since
+            // Arduino String would otherwise realloc on every append
+            size_t grow = reserved + reserved / 2;
+            size_t previous = reserved;
+            reserved = needed > grow ? needed : grow;
+            out.reserve(reserved);
+            if (previous + reserved > peakBuffer) peakBuffer = previous + reserved;
+        }
+        out.concat(pending, pendingLen);
+        pendingLen = 0;
+    }
+
+    void put(char c) {
+        if (pendingLen == PENDING_SIZE) flush();
+        pending[pendingLen++] = c;
+    }
+
+    void flushWhitespace() {
+        if (runNewlines > 0) {
+            put('\n');
+            if (runNewlines > 1) put('\n');
+        } else if (runSpace) {
+            put(' ');
+        }
+        runSpace = false;
+        runNewlines = 0;
+    }
+
+    void emitText(const char* s, int n) {
+        flushWhitespace();
+        for (int k = 0; k < n; k++) put(s[k]);
+        anyText = true;
+        afterBreak = false;
+    }
+
+    void emitSpace() {
+        runSpace = true;
+        anyText = true;
+        afterBreak = false;
+    }
 
-                // Check for closing tags to disable ignore mode
-                if (html.substring(i, i+8).equalsIgnoreCase("</style>")) ignoreContent = false;
-                if (html.substring(i, i+9).equalsIgnoreCase("</script>")) ignoreContent = false;
-                if (html.substring(i, i+7).equalsIgnoreCase("</head>")) ignoreContent = false;
-                
-                // Closing block tags
-                if (html.substring(i, i+4).equalsIgnoreCase("</p>") || 
-                    html.substring(i, i+6).equalsIgnoreCase("</div>")) {
-                     if (script.length() > 0 && script[script.length()-1] != '\n') script += '\n';
+    void blockBreak() {
+        if (skipUntil || !anyText || afterBreak) return;
+        runNewlines++;
+        afterBreak = true;
+    }
+
+    // Binary search over the generated tables (see tools/gen_html_entities.py)
+    static const HTMLEntity* findEntity(const char* name, int len) {
+        int lo = 0, hi = HTML_ENTITY_COUNT - 1;
+        while (lo <= hi) {
+            int mid = (lo + hi) / 2;
+            const char* candidate = HTML_ENTITIES[mid].name;
+            int cmp = strncmp(candidate, name, len);
+            if (cmp == 0 && candidate[len] != '\0') cmp = 1;
+            if (cmp == 0) return &HTML_ENTITIES[mid];
+            if (cmp < 0) lo = mid + 1;
+            else hi = mid - 1;
+        }
+        return nullptr;
+    }
+
+    static const HTMLFallback* findFallback(uint32_t cp) {
+        int lo = 0, hi = HTML_FALLBACK_COUNT - 1;
+        while (lo <= hi) {
+            int mid = (lo + hi) / 2;
+            if (HTML_FALLBACKS[mid].codepoint == cp) return &HTML_FALLBACKS[mid];
+            if (HTML_FALLBACKS[mid].codepoint < cp) lo = mid + 1;
+            else hi = mid - 1;
+        }
+        return nullptr;
+    }
+
+    // Typographic punctuation the display font lacks is mapped to ASCII
+    void emitCodepoint(uint32_t cp) {
+        if (cp == 0x09 || cp == 0x0A || cp == 0x0D || cp == 0x20) {
+            emitSpace();
+            return;
+        }
+        if (cp >= 0xA0) {
+            const HTMLFallback* fallback = findFallback(cp);
+            if (fallback) {
+                if (fallback->text[0] == ' ') emitSpace();
+                else if (fallback->text[0]) emitText(fallback->text, strlen(fallback->text));
+                return;
+            }
+        }
+        char buf[4];
+        int n;
+        if (cp < 0x80) {
+            buf[0] = cp; n = 1;
+        } else if (cp < 0x800) {
+            buf[0] = 0xC0 | (cp >> 6); buf[1] = 0x80 | (cp & 0x3F); n = 2;
+        } else if (cp < 0x10000) {
+            buf[0] = 0xE0 | (cp >> 12); buf[1] = 0x80 | ((cp >> 6) & 0x3F); buf[2] = 0x80 | (cp & 0x3F); n = 3;
+        } else {
+            buf[0] = 0xF0 | (cp >> 18); buf[1] = 0x80 | ((cp >> 12) & 0x3F);
+            buf[2] = 0x80 | ((cp >> 6) & 0x3F); buf[3] = 0x80 | (cp & 0x3F); n = 4;
+        }
+        emitText(buf, n);
+    }
+
+    void onText(char c) {
+        unsigned char u = (unsigned char)c;
+
+        // Continue a multi-byte UTF-8 sequence
+        if (utf8Len > 0) {
+            if ((u & 0xC0) == 0x80) {
+                utf8Buf[utf8Len++] = c;
+                if (utf8Len == utf8Need) {
+                    uint32_t cp = (unsigned char)utf8Buf[0] & (0x7F >> utf8Need);
+                    for (int k = 1; k < utf8Len; k++) cp = (cp << 6) | ((unsigned char)utf8Buf[k] & 0x3F);
+                    utf8Len = 0;
+                    emitCodepoint(cp);
                 }
+                return;
+            }
+            // Malformed sequence: pass the bytes through untouched
+            emitText(utf8Buf, utf8Len);
+            utf8Len = 0;
+        }
+
+        if (c == '<') {
+            state = TAG_OPEN;
+            return;
+        }
+        if (skipUntil) return;
+
+        if (c == '&') {
+            entityLen = 0;
+            state = ENTITY;
+        } else if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+            // Source line breaks are plain whitespace; logical newlines come from block tags
+            emitSpace();
+        } else if (u >= 0xC0 && u < 0xF8) {
+            utf8Buf[0] = c;
+            utf8Len = 1;
+            utf8Need = u >= 0xF0 ? 4 : (u >= 0xE0 ? 3 : 2);
+        } else {
+            emitText(&c, 1);
+        }
+    }
+
+    void onTagOpen(char c) {
+        tagNameLen = 0;
+        tagClosing = false;
+        tagSelfClosing = false;
+        quote = 0;
+        if (skipUntil && c != '/') {
+            // Only a close tag can end skipped content ("a<b" in a script is text)
+            state = TEXT;
+            onText(c);
+        } else if (c == '!') {
+            commentDashes = 0;
+            state = COMMENT;
+        } else if (c == '?') {
+            state = DECL;
+        } else if (c == '/') {
+            tagClosing = true;
+            state = TAG_NAME;
+        } else if (c == '>') {
+            state = TEXT;
+        } else {
+            state = TAG_NAME;
+            onTagName(c);
+        }
+    }
+
+    void onTagName(char c) {
+        if (c == '>' || c == '/' || c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+            state = TAG_ATTRS;
+            onTagAttrs(c);
+            return;
+        }
+        if (tagNameLen < MAX_TAG_NAME) tagName[tagNameLen] = tolower((unsigned char)c);
+        if (tagNameLen <= MAX_TAG_NAME) tagNameLen++;
+    }
+
+    void onTagAttrs(char c) {
+        if (quote) {
+            if (c == quote) quote = 0;
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == '>') {
+            state = TEXT;
+            endTag();
+        } else if (c == '/') {
+            tagSelfClosing = true;
+        } else if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+            tagSelfClosing = false;
+        }
+    }
+
+    bool tagIs(const char* name) const {
+        int n = strlen(name);
+        return tagNameLen == n && memcmp(tagName, name, n) == 0;
+    }
 
-                continue;
+    bool isBlockTag() const {
+        if (tagNameLen == 2 && tagName[0] == 'h' && tagName[1] >= '1' && tagName[1] <= '6') return true;
+        return tagIs("p") || tagIs("div") || tagIs("br") || tagIs("li") || tagIs("blockquote");
+    }
+
+    void endTag() {
+        if (skipUntil) {
+            if (tagClosing && tagIs(skipUntil)) skipUntil = nullptr;
+            return;
+        }
+        if (!tagClosing && !tagSelfClosing) {
+            static const char* const skipped[] = { "style", "script", "head" };
+            for (const char* name : skipped) {
+                if (tagIs(name)) {
+                    skipUntil = name;
+                    return;
+                }
             }
-            
-            if (c == '>') {
-                insideTag = false;
-                continue;
+        }
+        if (isBlockTag()) blockBreak();
+    }
+
+    // "<!--" ... "-->"; any other "<!" (DOCTYPE, CDATA) is skipped to the next '>'
+    void onComment(char c) {
+        if (commentDashes < 2) {
+            if (c == '-') commentDashes++;
+            else state = c == '>' ? TEXT : DECL;
+            return;
+        }
+        if (c == '-') {
+            if (commentDashes < 4) commentDashes++;
+        } else if (c == '>' && commentDashes == 4) {
+            state = TEXT;
+        } else {
+            commentDashes = 2;
+        }
+    }
+
+    void onEntity(char c) {
+        if (c == ';') {
+            state = TEXT;
+            decodeEntity();
+            return;
+        }
+        bool valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+            || (c == '#' && entityLen == 0);
+        if (!valid || entityLen == MAX_ENTITY) {
+            // Not an entity after all: keep the text and rescan c
+            flushRawEntity();
+            onText(c);
+            return;
+        }
+        entityBuf[entityLen++] = c;
+    }
+
+    void flushRawEntity() {
+        state = TEXT;
+        emitText("&", 1);
+        emitText(entityBuf, entityLen);
+    }
+
+    bool decodeNumeric(uint32_t& cp) const {
+        bool hex = entityLen > 1 && (entityBuf[1] == 'x' || entityBuf[1] == 'X');
+        int first = hex ? 2 : 1;
+        if (entityLen <= first) return false;
+        cp = 0;
+        for (int k = first; k < entityLen; k++) {
+            char d = entityBuf[k];
+            int v;
+            if (d >= '0' && d <= '9') v = d - '0';
+            else if (hex && d >= 'a' && d <= 'f') v = d - 'a' + 10;
+            else if (hex && d >= 'A' && d <= 'F') v = d - 'A' + 10;
+            else return false;
+            cp = cp * (hex ? 16 : 10) + v;
+            if (cp > 0x10FFFF) return false;
+        }
+        if (cp >= 0x80 && cp < 0xA0) cp = HTML_CP1252_C1[cp - 0x80];
+        return cp > 0;
+    }
+
+    void decodeEntity() {
+        uint32_t cp;
+        if (entityLen > 0 && entityBuf[0] == '#') {
+            if (decodeNumeric(cp)) {
+                emitCodepoint(cp);
+                return;
             }
-            
-            if (!insideTag && !ignoreContent) {
-                // Collapse whitespace: If we encounter a newline/tab/space, convert to space
-                // ONLY if the previous char wasn't usually a newline or space.
-                // But simplified: just append, we clean up later.
-                // Actually, let's just treat standard newlines in HTML as spaces (standard variable width rule),
-                // UNLESS we just inserted a logical newline from a tag.
-                if (c == '\n' || c == '\r' || c == '\t') c = ' ';
-                
-                script += c;
+        } else {
+            const HTMLEntity* entity = findEntity(entityBuf, entityLen);
+            if (entity) {
+                emitCodepoint(entity->codepoint);
+                if (entity->codepoint2) emitCodepoint(entity->codepoint2);
+                return;
             }
         }
-        
-        // Basic entity replacement
-        script.replace("&nbsp;", " ");
-        script.replace("&amp;", "&");
-        script.replace("&lt;", "<");
-        script.replace("&gt;", ">");
-        script.replace("&quot;", "\"");
-        script.replace("&#39;", "'");
-        script.replace("&mdash;", "---");
-        script.replace("&ndash;", "--");
-        script.replace("&hellip;", "...");
-        
-        // Unicode character replacements (common sources of blank squares)
-        // Single quotes
-        script.replace("\u2018", "'");
-        script.replace("\u2019", "'");
-        script.replace("&#8216;", "'");
-        script.replace("&#8217;", "'");
-        
-        // Double quotes
-        script.replace("\u201c", "\"");
-        script.replace("\u201d", "\"");
-        script.replace("&#8220;", "\"");
-        script.replace("&#8221;", "\"");
-        
-        // Dashes
-        script.replace("\u2013", "--");
-        script.replace("\u2014", "---");
-        script.replace("&#8211;", "--");
-        script.replace("&#8212;", "---");
-        
-        // Ellipsis
-        script.replace("\u2026", "...");
-        script.replace("&#8230;", "...");
-
-        // Other common ones
-        script.replace("\u00a0", " "); // non-breaking space
-        
-        // Collapse multiple spaces
-        while (script.indexOf("  ") != -1) {
-            script.replace("  ", " ");
-        }
-        
-        // Prepare for Paginator:
-        // We want paragraphs to be distinguished.
-        // We added '\n' for p/br/div. 
-        // Let's ensure we don't have " \n "
-        script.replace(" \n", "\n");
-        script.replace("\n ", "\n");
-        
-        // Multiple newlines -> Double Newline max?
-        while (script.indexOf("\n\n\n") != -1) {
-            script.replace("\n\n\n", "\n\n");
-        }
-        
-        return script;
+        // Unknown reference: keep it literally
+        flushRawEntity();
+        emitText(";", 1);
     }
 };
 
+inline String HTMLParser::stripTags(const String& html) {
+    HTMLStripper stripper;
+    stripper.reserve(html.length());
+    stripper.feed(html.c_str(), html.length());
+    return stripper.finish();
+}
+
 #endif
@@ -0,0 +1,367 @@
+#include "LibraryCatalog.h"
+#include "EpubReader.h"
+#include "ZipIndex.h"
+#include <algorithm>
+
+namespace {
+    const uint32_t CATALOG_MAGIC = 0x434C5248; // "HRLC"
+    const uint32_t ORDER_MAGIC = 0x4F4C5248;   // "HRLO"
+    const uint16_t CATALOG_VERSION = 3;
+
+    // What update() decided for each record of the old catalog
+    const uint8_t RECORD_GONE = 0;
+    const uint8_t RECORD_KEPT = 1;
+    const uint8_t RECORD_REPLACED = 2; // rescanned; its cover slot moves to the new entry
+
+    struct Pending {
+        uint32_t bookId;
+        uint32_t record; // in the additions file
+    };
+
+    bool byId(const Pending& a, const Pending& b) {
+        return a.bookId < b.bookId;
+    }
+
+    // Case-folded prefix; enough to order a library. Ties go by rank, so
+    // sorting needs no buffer beyond the keys.
+    struct SortKey {
+        char text[20];
+        uint32_t rank;
+        uint32_t record;
+    };
+
+    void foldKey(SortKey& key, const char* text) {
+        memset(key.text, 0, sizeof(key.text));
+        // Books without the field go last
+        if (!text[0]) memset(key.text, 0xFF, sizeof(key.text));
+        for (size_t i = 0; i < sizeof(key.text) && text[i]; i++) key.text[i] = tolower((uint8_t)text[i]);
+    }
+
+    bool byKey(const SortKey& a, const SortKey& b) {
+        int cmp = memcmp(a.text, b.text, sizeof(a.text));
+        return cmp != 0 ? cmp < 0 : a.rank < b.rank;
+    }
+}
+
+LibraryCatalog::LibraryCatalog() {
+    count = 0;
+}
+
+LibraryCatalog::~LibraryCatalog() {
+    close();
+}
+
+bool LibraryCatalog::readHeader(File& f, int& entryCount, uint32_t& stamp) {
+    Header header;
+    bool valid = f.seek(0) && f.read((uint8_t*)&header, sizeof(header)) == sizeof(header)
+        && header.magic == CATALOG_MAGIC && header.version == CATALOG_VERSION
+        && header.entrySize == sizeof(Entry);
+    entryCount = valid ? header.entryCount : 0;
+    stamp = valid ? header.stamp : 0;
+    return valid;
+}
+
+bool LibraryCatalog::readEntry(File& f, int record, Entry& entry) {
+    return f.seek(sizeof(Header) + (size_t)record * sizeof(Entry))
+        && f.read((uint8_t*)&entry, sizeof(Entry)) == sizeof(Entry);
+}
+
+bool LibraryCatalog::open(const String& catalogPath) {
+    close();
+    path = catalogPath;
+
+    catalogFile = LittleFS.open(path, "r");
+    int entries = 0;
+    uint32_t stamp = 0;
+    if (!catalogFile || !readHeader(catalogFile, entries, stamp)) {
+        close();
+        return false;
+    }
+
+    // Orders missing or left over from another catalog (power cut mid-install): rebuild them
+    for (int attempt = 0; attempt < 2; attempt++) {
+        orderFile = LittleFS.open(orderPath(), "r");
+        OrderHeader header;
+        bool valid = orderFile && orderFile.read((uint8_t*)&header, sizeof(header)) == sizeof(header)
+            && header.magic == ORDER_MAGIC && header.version == CATALOG_VERSION
+            && header.entryCount == (uint32_t)entries && header.catalogStamp == stamp;
+        if (valid) {
+            count = entries;
+            return true;
+        }
+        if (orderFile) orderFile.close();
+        if (attempt == 0) buildOrders(path, orderPath());
+    }
+    close();
+    return false;
+}
+
+void LibraryCatalog::close() {
+    if (catalogFile) catalogFile.close();
+    if (orderFile) orderFile.close();
+    count = 0;
+}
+
+int LibraryCatalog::findRecord(File& f, int entryCount, uint32_t bookId) {
+    int lo = 0, hi = entryCount - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        // Only the id is read
+        uint32_t probe;
+        if (!f.seek(sizeof(Header) + (size_t)mid * sizeof(Entry) + offsetof(Entry, bookId))
+            || f.read((uint8_t*)&probe, sizeof(probe)) != sizeof(probe)) return -1;
+        if (probe == bookId) return mid;
+        if (probe < bookId) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+int LibraryCatalog::update(const String& dir) {
+    unsigned long startMs = millis();
+    releasedCovers.clear();
+
+    // Own handle: the UI keeps reading the installed catalog meanwhile
+    File old = LittleFS.open(path, "r");
+    int oldCount = 0;
+    uint32_t oldStamp = 0;
+    if (old && !readHeader(old, oldCount, oldStamp)) oldCount = 0;
+    std::vector<uint8_t> state(oldCount, RECORD_GONE);
+
+    // Newly scanned entries go to flash as they come, not into RAM
+    String addedPath = path + ".add";
+    File added = LittleFS.open(addedPath, "w");
+    File root = LittleFS.open(dir);
+    if (!added || !root) {
+        if (old) old.close();
+        if (added) added.close();
+        return -1;
+    }
+    Header addedHeader;
+    memset(&addedHeader, 0, sizeof(addedHeader));
+    added.write((const uint8_t*)&addedHeader, sizeof(addedHeader));
+    std::vector<Pending> pending;
+
+    while (true) {
+        File file = root.openNextFile();
+        if (!file) break;
+        String name = String(file.name());
+        bool isBook = !file.isDirectory() && (name.endsWith(".epub") || name.endsWith(".EPUB"));
+        uint32_t fileSize = isBook ? file.size() : 0;
+        uint32_t fileMtime = isBook ? (uint32_t)file.getLastWrite() : 0;
+        file.close();
+        if (!isBook) continue;
+        if (name.length() >= sizeof(Entry::name)) {
+            Serial.printf("Library: skipping %s, name too long\n", name.c_str());
+            continue;
+        }
+
+        Entry entry;
+        uint32_t bookId = ZipIndex::hashName(name.c_str());
+        int existing = oldCount > 0 ? findRecord(old, oldCount, bookId) : -1;
+        if (existing >= 0 && (!readEntry(old, existing, entry) || name != entry.name)) existing = -1;
+        if (existing >= 0 && entry.fileSize == fileSize && entry.fileMtime == fileMtime) {
+            state[existing] = RECORD_KEPT;
+            continue;
+        }
+
+        // A changed book keeps its cover slot; the thumbnail is rebuilt into it
+        int32_t coverSlot = existing >= 0 ? entry.coverSlot : -1;
+        if (existing >= 0) state[existing] = RECORD_REPLACED;
+        memset(&entry, 0, sizeof(entry));
+        copyField(entry.name, sizeof(entry.name), name);
+        entry.bookId = bookId;
+        entry.fileSize = fileSize;
+        entry.fileMtime = fileMtime;
+        entry.coverSlot = coverSlot;
+        String bookPath = dir.endsWith("/") ? dir + name : dir + "/" + name;
+        unsigned long scanMs = millis();
+        if (!scan(bookPath, entry)) entry.flags |= FLAG_UNREADABLE;
+        Serial.printf("Library: %s %s in %lu ms\n", existing >= 0 ? "rescanned" : "added", entry.name, millis() - scanMs);
+
+        Pending p;
+        p.bookId = bookId;
+        p.record = pending.size();
+        pending.push_back(p);
+        added.write((const uint8_t*)&entry, sizeof(entry));
+    }
+    root.close();
+    added.close();
+
+    int kept = std::count(state.begin(), state.end(), RECORD_KEPT);
+    int removed = std::count(state.begin(), state.end(), RECORD_GONE);
+    int scanned = pending.size();
+    if (scanned == 0 && removed == 0) {
+        if (old) old.close();
+        LittleFS.remove(addedPath);
+        Serial.printf("Library: %d books unchanged, checked in %lu ms\n", oldCount, millis() - startMs);
+        return -1;
+    }
+
+    // Merge the kept records with the new ones; both are in id order
+    std::sort(pending.begin(), pending.end(), byId);
+    added = LittleFS.open(addedPath, "r");
+    String newPath = path + ".new";
+    File out = LittleFS.open(newPath, "w");
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CATALOG_MAGIC;
+    header.version = CATALOG_VERSION;
+    header.entrySize = sizeof(Entry);
+    header.entryCount = kept + scanned;
+    header.stamp = oldStamp + 1;
+    bool ok = out && added && out.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+
+    Entry a, b;
+    bool hasA = false, hasB = false;
+    int i = 0;
+    size_t j = 0;
+    while (ok) {
+        while (ok && !hasA && i < oldCount) {
+            ok = readEntry(old, i, a);
+            if (ok && state[i] == RECORD_KEPT) hasA = true;
+            else if (ok && state[i] == RECORD_GONE && a.coverSlot >= 0) releasedCovers.push_back(a.coverSlot);
+            i++;
+        }
+        if (ok && !hasB && j < pending.size()) {
+            ok = hasB = readEntry(added, pending[j].record, b);
+            j++;
+        }
+        if (!ok || (!hasA && !hasB)) break;
+        bool takeA = hasA && (!hasB || a.bookId < b.bookId);
+        ok = out.write((const uint8_t*)(takeA ? &a : &b), sizeof(Entry)) == sizeof(Entry);
+        if (takeA) hasA = false;
+        else hasB = false;
+    }
+    if (out) out.close();
+    if (added) added.close();
+    if (old) old.close();
+    LittleFS.remove(addedPath);
+
+    ok = ok && buildOrders(newPath, orderPath() + ".new");
+    if (!ok) {
+        LittleFS.remove(newPath);
+        Serial.println("Library: could not write catalog");
+        return -1;
+    }
+    Serial.printf("Library: %d books (%d scanned, %d removed) in %lu ms\n", kept + scanned, scanned, removed, millis() - startMs);
+    return scanned;
+}
+
+bool LibraryCatalog::install() {
+    String newPath = path + ".new";
+    String newOrders = orderPath() + ".new";
+    if (!LittleFS.exists(newPath) || !LittleFS.exists(newOrders)) return false;
+    close();
+    // A cut between the renames leaves orders of another stamp; open() rebuilds them
+    LittleFS.remove(path);
+    LittleFS.rename(newPath, path);
+    LittleFS.remove(orderPath());
+    LittleFS.rename(newOrders, orderPath());
+    return open(path);
+}
+
+bool LibraryCatalog::buildOrders(const String& catalog, const String& orders) {
+    unsigned long startMs = millis();
+    File f = LittleFS.open(catalog, "r");
+    int n = 0;
+    uint32_t stamp = 0;
+    if (!f || !readHeader(f, n, stamp)) {
+        if (f) f.close();
+        return false;
+    }
+
+    File out = LittleFS.open(orders, "w");
+    OrderHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = ORDER_MAGIC;
+    header.version = CATALOG_VERSION;
+    header.orderCount = SORT_ORDER_COUNT;
+    header.entryCount = n;
+    header.catalogStamp = stamp;
+    bool ok = out && out.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+
+    std::vector<SortKey> keys(n);
+    Entry entry;
+    for (int i = 0; ok && i < n; i++) {
+        ok = readEntry(f, i, entry);
+        foldKey(keys[i], entry.title[0] ? entry.title : entry.name);
+        keys[i].rank = i;
+        keys[i].record = i;
+    }
+    // Title order, then author order with equal authors in title order
+    std::sort(keys.begin(), keys.end(), byKey);
+    for (int i = 0; ok && i < n; i++) ok = out.write((const uint8_t*)&keys[i].record, 4) == 4;
+    for (int i = 0; ok && i < n; i++) {
+        ok = readEntry(f, keys[i].record, entry);
+        foldKey(keys[i], entry.author);
+        keys[i].rank = i;
+    }
+    std::sort(keys.begin(), keys.end(), byKey);
+    for (int i = 0; ok && i < n; i++) ok = out.write((const uint8_t*)&keys[i].record, 4) == 4;
+
+    f.close();
+    if (out) out.close();
+    if (!ok) LittleFS.remove(orders);
+    else Serial.printf("Library: sorted %d books in %lu ms\n", n, millis() - startMs);
+    return ok;
+}
+
+bool LibraryCatalog::read(int record, Entry& entry) {
+    if (record < 0 || record >= count) return false;
+    return readEntry(catalogFile, record, entry);
+}
+
+bool LibraryCatalog::readSorted(SortOrder order, int position, Entry& entry) {
+    if (position < 0 || position >= count || order < 0 || order >= SORT_ORDER_COUNT) return false;
+    uint32_t record;
+    if (!orderFile.seek(sizeof(OrderHeader) + ((size_t)order * count + position) * 4)
+        || orderFile.read((uint8_t*)&record, 4) != 4) return false;
+    return read(record, entry);
+}
+
+int LibraryCatalog::findById(uint32_t bookId) {
+    return findRecord(catalogFile, count, bookId);
+}
+
+bool LibraryCatalog::setCoverSlot(int record, int32_t slot) {
+    if (record < 0 || record >= count) return false;
+    // Written through its own handle; the read handle is reopened so it can't serve stale data
+    catalogFile.close();
+    File f = LittleFS.open(path, "r+");
+    bool ok = f && f.seek(sizeof(Header) + (size_t)record * sizeof(Entry) + offsetof(Entry, coverSlot))
+        && f.write((const uint8_t*)&slot, sizeof(slot)) == sizeof(slot);
+    if (f) f.close();
+    catalogFile = LittleFS.open(path, "r");
+    return ok;
+}
+
+String LibraryCatalog::displayTitle(const Entry& entry) {
+    return entry.title[0] ? String(entry.title) : String(entry.name);
+}
+
+bool LibraryCatalog::scan(const String& bookPath, Entry& entry) {
+    EpubReader book;
+    if (!book.open(bookPath.c_str())) return false;
+    const EpubMetadata& meta = book.getMetadata();
+    copyField(entry.title, sizeof(entry.title), meta.title);
+    copyField(entry.author, sizeof(entry.author), meta.author);
+    copyField(entry.language, sizeof(entry.language), meta.language);
+    copyField(entry.identifier, sizeof(entry.identifier), meta.identifier);
+    entry.chapterCount = book.getChapters().size();
+    entry.textSize = book.getChapterStarts().empty() ? 0 : book.getChapterStarts().back();
+    if (!book.hasCover()) entry.flags |= FLAG_NO_COVER;
+    book.close();
+    return entry.chapterCount > 0;
+}
+
+void LibraryCatalog::copyField(char* dst, size_t size, const String& src) {
+    size_t n = src.length();
+    if (n >= size) {
+        // Don't cut a multi-byte character in half
+        n = size - 1;
+        while (n > 0 && ((uint8_t)src[n] & 0xC0) == 0x80) n--;
+    }
+    memcpy(dst, src.c_str(), n);
+    dst[n] = '\0';
+}
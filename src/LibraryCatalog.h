@@ -0,0 +1,100 @@
+#ifndef LIBRARY_CATALOG_H
+#define LIBRARY_CATALOG_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <vector>
+
+// Metadata of every book on LittleFS ("/library.hlc"), so the home screen
+// never has to open an EPUB. Nothing is held in RAM: entries are read from
+// flash by position, directly or through a sort order ("/library.hlc.ord"),
+// so opening the catalog and drawing a screen of it cost the same for ten
+// books or ten thousand.
+//
+// update() compares the directory with the catalog by file size and mtime,
+// opens only new or changed books and writes the new catalog and orders
+// beside the old ones; install() swaps them in. The two are split so update()
+// can run in the background while the UI keeps reading the installed catalog.
+//
+// Catalog file (little endian): Header, then Entry[entryCount] sorted by
+// bookId, so a book is found by binary search on its name hash. Order file:
+// OrderHeader, then uint32 record[entryCount] by title, then by author.
+class LibraryCatalog {
+public:
+    struct Entry {
+        char name[64];          // file name in the library directory
+        char title[96];         // UTF-8, truncated on a character boundary
+        char author[64];
+        char language[16];
+        char identifier[64];
+        uint32_t bookId;        // hash of the file name
+        uint32_t fileSize;
+        uint32_t fileMtime;
+        uint32_t textSize;      // uncompressed bytes of the spine
+        uint16_t chapterCount;  // spine length
+        uint16_t flags;
+        int32_t coverSlot;      // CoverCache slot, -1 until a thumbnail is built
+    };
+    static const uint16_t FLAG_UNREADABLE = 1; // open failed; kept so it isn't retried every boot
+    static const uint16_t FLAG_NO_COVER = 2;   // OPF names no cover image
+
+    enum SortOrder { SORT_TITLE, SORT_AUTHOR, SORT_ORDER_COUNT };
+
+    LibraryCatalog();
+    ~LibraryCatalog();
+
+    // Opens the saved catalog; reads only the headers
+    bool open(const String& catalogPath);
+    void close();
+
+    // Builds the next catalog and orders for the .epub files in dir. Returns
+    // the number of books that had to be opened, or -1 if nothing changed.
+    int update(const String& dir);
+    // Replaces the open catalog with the one update() built
+    bool install();
+    // Cover slots of books update() dropped, for the caller to free
+    const std::vector<int32_t>& getReleasedCovers() const { return releasedCovers; }
+
+    int getCount() const { return count; }
+    bool read(int record, Entry& entry);
+    bool readSorted(SortOrder order, int position, Entry& entry);
+    // Record of a book, -1 if it isn't in the catalog
+    int findById(uint32_t bookId);
+    bool setCoverSlot(int record, int32_t slot);
+
+    // Title for display: dc:title, else the file name
+    static String displayTitle(const Entry& entry);
+
+private:
+    struct Header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t entrySize;
+        uint32_t entryCount;
+        uint32_t stamp;         // bumped by every update()
+    };
+    struct OrderHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t orderCount;
+        uint32_t entryCount;
+        uint32_t catalogStamp;  // stamp of the catalog the orders were built from
+    };
+
+    String path;
+    File catalogFile;
+    File orderFile;
+    int count;
+    std::vector<int32_t> releasedCovers;
+
+    String orderPath() const { return path + ".ord"; }
+    static bool readEntry(File& f, int record, Entry& entry);
+    static int findRecord(File& f, int entryCount, uint32_t bookId);
+    static bool readHeader(File& f, int& entryCount, uint32_t& stamp);
+    // Writes the order file for a catalog file; needs RAM for a short sort key per book
+    static bool buildOrders(const String& catalog, const String& orders);
+    static bool scan(const String& bookPath, Entry& entry);
+    static void copyField(char* dst, size_t size, const String& src);
+};
+
+#endif
@@ -0,0 +1,225 @@
+#include "PageCache.h"
+#include "miniz.h"
+
+namespace {
+    const uint32_t CACHE_MAGIC = 0x43505248; // "HRPC"
+    const uint16_t CACHE_VERSION = 1;
+
+    void putVarint(std::vector<uint8_t>& out, uint32_t v) {
+        while (v >= 0x80) {
+            out.push_back((v & 0x7F) | 0x80);
+            v >>= 7;
+        }
+        out.push_back(v);
+    }
+
+    bool getVarint(const uint8_t*& p, const uint8_t* end, uint32_t& v) {
+        v = 0;
+        for (int shift = 0; shift < 35 && p < end; shift += 7) {
+            uint8_t b = *p++;
+            v |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+
+    // Zigzag so small negative deltas stay one byte
+    uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+    int32_t unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+    uint16_t sizeKey(float textSize) { return (uint16_t)(textSize * 100 + 0.5f); }
+}
+
+PageCache::PageCache() {
+    opened = false;
+    fileSize = 0;
+    hits = 0;
+    misses = 0;
+}
+
+PageCache::~PageCache() {
+    close();
+}
+
+bool PageCache::open(const String& bookPath) {
+    close();
+
+    File src = LittleFS.open(bookPath, "r");
+    if (!src) return false;
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.reserved = 0;
+    header.sourceSize = src.size();
+    header.sourceMtime = (uint32_t)src.getLastWrite();
+    src.close();
+
+    path = cachePath(bookPath);
+    File f = LittleFS.open(path, "r");
+    Header existing;
+    bool valid = f && f.read((uint8_t*)&existing, sizeof(existing)) == sizeof(existing)
+        && existing.magic == CACHE_MAGIC && existing.version == CACHE_VERSION
+        && existing.sourceSize == header.sourceSize && existing.sourceMtime == header.sourceMtime;
+
+    if (valid) {
+        fileSize = f.size();
+        // A torn append from a power cut: start over rather than build on it
+        valid = scanRecords(f);
+    }
+    if (f) f.close();
+
+    if (!valid && !reset()) return false;
+
+    opened = true;
+    Serial.printf("PageCache: %s has %d layouts (%d bytes)\n", path.c_str(), records.size(), fileSize);
+    return true;
+}
+
+void PageCache::close() {
+    opened = false;
+    records.clear();
+    fileSize = 0;
+}
+
+bool PageCache::reset() {
+    records.clear();
+    File f = LittleFS.open(path, "w");
+    if (!f) return false;
+    bool ok = f.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+    f.close();
+    fileSize = ok ? sizeof(header) : 0;
+    return ok;
+}
+
+bool PageCache::scanRecords(File& f) {
+    size_t offset = sizeof(Header);
+    while (offset + sizeof(RecordHeader) <= fileSize) {
+        RecordRef ref;
+        if (!f.seek(offset) || f.read((uint8_t*)&ref.header, sizeof(ref.header)) != sizeof(ref.header)) break;
+        ref.payloadOffset = offset + sizeof(RecordHeader);
+        if (ref.payloadOffset + ref.header.payloadSize > fileSize) break;
+        records.push_back(ref);
+        offset = ref.payloadOffset + ref.header.payloadSize;
+    }
+    return offset == fileSize;
+}
+
+void PageCache::report(const char* what, int chapter, float textSize, size_t bytes) {
+    Serial.printf("PageCache: %s Ch %d @%.1f (%d bytes) - %d hits / %d misses, %d bytes on flash\n",
+                  what, chapter + 1, textSize, bytes, hits, misses, fileSize);
+}
+
+bool PageCache::load(int chapter, float textSize, int viewWidth, int viewHeight,
+                     std::vector<PageInfo>& pages, std::vector<LineInfo>& lines) {
+    if (!opened) return false;
+
+    const RecordRef* ref = nullptr;
+    for (const RecordRef& r : records) {
+        if (r.header.chapter == chapter && r.header.textSize == sizeKey(textSize)
+            && r.header.viewWidth == viewWidth && r.header.viewHeight == viewHeight) {
+            ref = &r;
+        }
+    }
+    if (!ref) {
+        misses++;
+        report("miss", chapter, textSize, 0);
+        return false;
+    }
+
+    std::vector<uint8_t> payload(ref->header.payloadSize);
+    File f = LittleFS.open(path, "r");
+    bool ok = f && f.seek(ref->payloadOffset) && f.read(payload.data(), payload.size()) == payload.size();
+    if (f) f.close();
+    ok = ok && mz_crc32(MZ_CRC32_INIT, payload.data(), payload.size()) == ref->header.crc;
+
+    // Pages and lines are contiguous, so only lengths/counts and small gaps are stored
+    const uint8_t* p = payload.data();
+    const uint8_t* end = p + payload.size();
+    pages.resize(ok ? ref->header.pageCount : 0);
+    lines.resize(ok ? ref->header.lineCount : 0);
+    uint32_t pos = 0, line = 0;
+    for (size_t i = 0; ok && i < pages.size(); i++) {
+        uint32_t gap, length, count;
+        ok = getVarint(p, end, gap) && getVarint(p, end, length) && getVarint(p, end, count);
+        pages[i] = { (int)(pos + gap), (int)length, (int)line, (int)count };
+        pos += gap + length;
+        line += count;
+    }
+    pos = 0;
+    int32_t y = 0;
+    for (size_t i = 0; ok && i < lines.size(); i++) {
+        uint32_t gap, length, dy;
+        ok = getVarint(p, end, gap) && getVarint(p, end, length) && getVarint(p, end, dy);
+        y += unzigzag(dy);
+        lines[i] = { pos + gap, (uint16_t)length, (uint16_t)y };
+        pos += gap + length;
+    }
+    if (!ok || line != lines.size()) {
+        pages.clear();
+        lines.clear();
+        misses++;
+        report("corrupt", chapter, textSize, 0);
+        return false;
+    }
+
+    hits++;
+    report("hit", chapter, textSize, payload.size());
+    return true;
+}
+
+bool PageCache::store(int chapter, float textSize, int viewWidth, int viewHeight,
+                      const std::vector<PageInfo>& pages, const std::vector<LineInfo>& lines) {
+    if (!opened) return false;
+
+    std::vector<uint8_t> payload;
+    payload.reserve(pages.size() * 4 + lines.size() * 3);
+    uint32_t pos = 0;
+    for (const PageInfo& page : pages) {
+        putVarint(payload, page.start - pos);
+        putVarint(payload, page.length);
+        putVarint(payload, page.lineCount);
+        pos = page.start + page.length;
+    }
+    pos = 0;
+    int32_t y = 0;
+    for (const LineInfo& line : lines) {
+        putVarint(payload, line.start - pos);
+        putVarint(payload, line.length);
+        putVarint(payload, zigzag((int32_t)line.y - y));
+        pos = line.start + line.length;
+        y = line.y;
+    }
+
+    RecordHeader rec;
+    rec.chapter = chapter;
+    rec.textSize = sizeKey(textSize);
+    rec.viewWidth = viewWidth;
+    rec.viewHeight = viewHeight;
+    rec.pageCount = pages.size();
+    rec.lineCount = lines.size();
+    rec.payloadSize = payload.size();
+    rec.crc = mz_crc32(MZ_CRC32_INIT, payload.data(), payload.size());
+
+    if (fileSize + sizeof(rec) + payload.size() > MAX_FILE_SIZE) {
+        Serial.printf("PageCache: %s full, starting over\n", path.c_str());
+        if (!reset()) return false;
+    }
+
+    File f = LittleFS.open(path, "a");
+    bool ok = f
+        && f.write((const uint8_t*)&rec, sizeof(rec)) == sizeof(rec)
+        && f.write(payload.data(), payload.size()) == payload.size();
+    if (f) f.close();
+    if (!ok) {
+        // Don't append after a partial record
+        reset();
+        return false;
+    }
+
+    RecordRef ref;
+    ref.header = rec;
+    ref.payloadOffset = fileSize + sizeof(rec);
+    records.push_back(ref);
+    fileSize = ref.payloadOffset + payload.size();
+    report("stored", chapter, textSize, payload.size());
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <vector>
+#include "Paginator.h"
+
+// Persistent layout cache for books that aren't compiled ("<book>.pgc").
+// Each record holds the page and line tables of one chapter for one text
+// size and viewport, varint/delta encoded (about 3 bytes per line instead
+// of 8). Records are appended as chapters get laid out; the file is tied to
+// the book's size and mtime and rebuilt when the book changes.
+class PageCache {
+public:
+    PageCache();
+    ~PageCache();
+
+    // Binds the cache to a book (creates or resets the file as needed)
+    bool open(const String& bookPath);
+    void close();
+    bool isOpen() const { return opened; }
+
+    bool load(int chapter, float textSize, int viewWidth, int viewHeight,
+              std::vector<PageInfo>& pages, std::vector<LineInfo>& lines);
+    bool store(int chapter, float textSize, int viewWidth, int viewHeight,
+               const std::vector<PageInfo>& pages, const std::vector<LineInfo>& lines);
+
+    int getHits() const { return hits; }
+    int getMisses() const { return misses; }
+    size_t getFileSize() const { return fileSize; }
+
+    static String cachePath(const String& bookPath) { return bookPath + ".pgc"; }
+
+private:
+    // Past this the file is started over rather than grown
+    static const size_t MAX_FILE_SIZE = 2 * 1024 * 1024;
+
+    struct Header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t reserved;
+        uint32_t sourceSize;
+        uint32_t sourceMtime;
+    };
+
+    struct RecordHeader {
+        uint16_t chapter;
+        uint16_t textSize;      // x100
+        uint16_t viewWidth;
+        uint16_t viewHeight;
+        uint32_t pageCount;
+        uint32_t lineCount;
+        uint32_t payloadSize;
+        uint32_t crc;           // of the payload
+    };
+
+    // Location of a record's payload, indexed at open
+    struct RecordRef {
+        RecordHeader header;
+        uint32_t payloadOffset;
+    };
+
+    String path;
+    bool opened;
+    Header header;
+    size_t fileSize;
+    std::vector<RecordRef> records;
+    int hits;
+    int misses;
+
+    bool reset();
+    // Indexes the records; false if the file ends in a partial one
+    bool scanRecords(File& f);
+    void report(const char* what, int chapter, float textSize, size_t bytes);
+};
+
+#endif
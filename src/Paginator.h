@@ -4,41 +4,72 @@
 #include <Arduino.h>
 #include <M5Unified.h>
 #include <vector>
+#include "FontMetrics.h"
+
+// One laid-out line: a run of text drawn at y (relative to the page top).
+// Blank lines have no entry; they only push the next line's y down.
+struct LineInfo {
+    uint32_t start;
+    uint16_t length;
+    uint16_t y;
+};
 
 struct PageInfo {
     int start;
     int length;
+    int firstLine;   // index into the chapter's LineInfo table
+    int lineCount;
 };
 
-class Paginator {
+// Resumable word-wrap layout: each step() lays out text up to the next page
+// break, so a caller can show the first pages of a chapter and finish the
+// rest later. The text must stay alive and unchanged until done.
+class PageLayouter {
 public:
-    // Splits text into pages based on dimensions and font size
-    static std::vector<PageInfo> paginate(const String& text, int x, int y, int width, int height, float textSize) {
-        std::vector<PageInfo> pages;
-        if (text.length() == 0) return pages;
+    PageLayouter() {}
 
-        M5.Display.setTextSize(textSize);
-        int spaceWidth = M5.Display.textWidth(" ");
-        int lineHeight = M5.Display.fontHeight();
-        
-        int cursorX = 0;
-        int cursorY = 0;
-        
-        int pageStart = 0;
-        int i = 0;
-        int len = text.length();
+    // Measures with gfx's font tables only; no drawing state is touched, even
+    // when the table for this size has to be built first
+    void begin(const String& layoutText, int layoutWidth, int layoutHeight, float textSize,
+               lgfx::LovyanGFX& gfx = M5.Display) {
+        text = &layoutText;
+        metrics = &FontMetrics::get(gfx, textSize);
+        width = layoutWidth;
+        height = layoutHeight;
+        cursorX = 0;
+        cursorY = 0;
+        pageStart = 0;
+        pageFirstLine = 0;
+        lineStart = -1;
+        lineEnd = 0;
+        i = 0;
+        done = layoutText.length() == 0;
+    }
+
+    bool isDone() const { return done; }
+
+    // Appends the next page (and its lines). Returns false once the whole
+    // text has been laid out.
+    bool step(std::vector<PageInfo>& pages, std::vector<LineInfo>& lines) {
+        if (done) return false;
+
+        int spaceWidth = metrics->getSpaceWidth();
+        int lineHeight = metrics->getLineHeight();
+        const char* buf = text->c_str();
+        int len = text->length();
+        size_t pageCount = pages.size();
         
-        while (i < len) {
+        while (i < len && pages.size() == pageCount) {
             // Check for explicit newline
-            if (text[i] == '\n') {
+            if (buf[i] == '\n') {
+                endLine(lines);
                 cursorX = 0;
                 cursorY += lineHeight;
                 i++;
                 
                 // Page Break Check
                 if (cursorY + lineHeight > height) {
-                    pages.push_back({pageStart, i - pageStart});
-                    pageStart = i;
+                    endPage(pages, lines, i);
                     cursorY = 0;
                     cursorX = 0;
                 }
@@ -48,13 +79,11 @@ public:
             // Identify word
             int wordStart = i;
             int wordEnd = i;
-            while (wordEnd < len && text[wordEnd] != ' ' && text[wordEnd] != '\n') {
+            while (wordEnd < len && buf[wordEnd] != ' ' && buf[wordEnd] != '\n') {
                 wordEnd++;
             }
             
-            // Extract word
-            String word = text.substring(wordStart, wordEnd);
-            int wordWidth = M5.Display.textWidth(word);
+            int wordWidth = metrics->textWidth(buf + wordStart, wordEnd - wordStart);
             
             // Logic: Does word fit on current line?
             bool wordFit = (cursorX + wordWidth <= width);
@@ -62,103 +91,122 @@ public:
             if (!wordFit) {
                 // If cursor is not at start of line, wrap to next line
                 if (cursorX > 0) {
+                    endLine(lines);
                     cursorX = 0;
                     cursorY += lineHeight;
                     
                     // Page Break Check on wrap
                     if (cursorY + lineHeight > height) {
-                         pages.push_back({pageStart, wordStart - pageStart});
-                         pageStart = wordStart;
+                         endPage(pages, lines, wordStart);
                          cursorY = 0;
                          cursorX = 0;
                     }
                 }
-                // If word is longer than entire width, we force it to print (char wrap implicitly by drawer? 
-                // or we accept it overflows X. Better to overflow X than break logic).
-                // For this simplistic engine, we assume words are < screen width.
+                // A word longer than the whole width is placed anyway and overflows
+                // (better than breaking the layout for this simple engine).
             }
             
             // Add word width
+            if (lineStart < 0) lineStart = wordStart;
+            lineEnd = wordEnd;
             cursorX += wordWidth;
             
             // Handle trailing space
-            if (wordEnd < len && text[wordEnd] == ' ') {
+            if (wordEnd < len && buf[wordEnd] == ' ') {
                 cursorX += spaceWidth;
                 wordEnd++; // Consume space
             }
             
             // Update iterator
             i = wordEnd;
-            
-             // Double check width overflow (if we just added a word that pushed exactly to edge, fine. If over?)
-             if (cursorX > width) {
-                 // Should have wrapped. The logic above handles wrapping BEFORE printing.
-                 // So here we are just updating X.
-             }
         }
+        if (i < len) return true;
         
         // Final page
+        endLine(lines);
         if (pageStart < len) {
-            pages.push_back({pageStart, len - pageStart});
+            endPage(pages, lines, len);
         }
-        
+        done = true;
+        return false;
+    }
+
+private:
+    const String* text = nullptr;
+    const FontMetrics* metrics = nullptr;
+    int width = 0;
+    int height = 0;
+    int cursorX = 0;
+    int cursorY = 0;
+    int pageStart = 0;
+    int pageFirstLine = 0;
+    int lineStart = -1;    // first char of the current line, -1 while it's empty
+    int lineEnd = 0;       // end of its last word
+    int i = 0;
+    bool done = true;
+
+    void endLine(std::vector<LineInfo>& lines) {
+        if (lineStart >= 0 && lineEnd > lineStart) {
+            lines.push_back({ (uint32_t)lineStart, (uint16_t)(lineEnd - lineStart), (uint16_t)cursorY });
+        }
+        lineStart = -1;
+    }
+
+    void endPage(std::vector<PageInfo>& pages, const std::vector<LineInfo>& lines, int pageEnd) {
+        pages.push_back({ pageStart, pageEnd - pageStart, pageFirstLine, (int)lines.size() - pageFirstLine });
+        pageStart = pageEnd;
+        pageFirstLine = lines.size();
+    }
+};
+
+class Paginator {
+public:
+    // Splits text into pages based on dimensions and font size, and fills
+    // lines with the line table drawPage replays.
+    // Measures with gfx (default: the display); background tasks pass their own
+    // off-screen canvas so they don't change the display's text size under the UI.
+    static std::vector<PageInfo> paginate(const String& text, int x, int y, int width, int height, float textSize,
+                                          std::vector<LineInfo>& lines, lgfx::LovyanGFX& gfx = M5.Display) {
+        std::vector<PageInfo> pages;
+        lines.clear();
+        PageLayouter layouter;
+        layouter.begin(text, width, height, textSize, gfx);
+        while (layouter.step(pages, lines)) {}
         return pages;
     }
 
-    // Draws a specific page content using the SAME logic
-    static void drawPage(const String& text, int startIndex, int length, int x, int y, int width, int height, float textSize, uint32_t color) {
-        if (startIndex >= text.length()) return;
-        
-        M5.Display.setTextSize(textSize);
-        M5.Display.setTextColor(color);
-        M5.Display.setCursor(x, y);
-        
-        int spaceWidth = M5.Display.textWidth(" ");
-        int lineHeight = M5.Display.fontHeight();
-        
-        int end = startIndex + length;
-        if (end > text.length()) end = text.length();
-        
-        int cursorX = 0;       // Relative to x
-        int cursorY = 0;       // Relative to y
+    // Page containing a text offset (binary search over page starts), so a
+    // reading position survives re-layout at another size or viewport
+    static int pageForOffset(const std::vector<PageInfo>& pages, int offset) {
+        int lo = 0, hi = (int)pages.size() - 1, found = 0;
+        while (lo <= hi) {
+            int mid = (lo + hi) / 2;
+            if (pages[mid].start <= offset) {
+                found = mid;
+                lo = mid + 1;
+            } else {
+                hi = mid - 1;
+            }
+        }
+        return found;
+    }
+
+    // Draws a page by replaying its line table: no measuring, no re-wrapping,
+    // so it can't disagree with paginate(). gfx may be an off-screen canvas.
+    static void drawPage(const String& text, const PageInfo& page, const std::vector<LineInfo>& lines,
+                         int x, int y, float textSize, uint32_t color, lgfx::LovyanGFX& gfx = M5.Display) {
+        gfx.setTextSize(textSize);
+        gfx.setTextColor(color);
         
-        int i = startIndex;
+        const char* buf = text.c_str();
+        int end = page.firstLine + page.lineCount;
+        if (end > (int)lines.size()) end = lines.size();
         
-        while (i < end) {
-             if (text[i] == '\n') {
-                cursorX = 0;
-                cursorY += lineHeight;
-                i++;
-                continue;
-            }
-            
-            int wordStart = i;
-            int wordEnd = i;
-            while (wordEnd < end && text[wordEnd] != ' ' && text[wordEnd] != '\n') {
-                wordEnd++;
-            }
-            
-            String word = text.substring(wordStart, wordEnd);
-            int wordWidth = M5.Display.textWidth(word);
-            
-            if (cursorX + wordWidth > width) {
-                if (cursorX > 0) {
-                    cursorX = 0;
-                    cursorY += lineHeight;
-                }
-            }
-            
-            M5.Display.setCursor(x + cursorX, y + cursorY);
-            M5.Display.print(word);
-            cursorX += wordWidth;
-            
-            if (wordEnd < end && text[wordEnd] == ' ') {
-                 // M5.Display.print(" "); // Avoid painting background for spaces if not needed
-                 cursorX += spaceWidth;
-                 wordEnd++;
-            }
-            
-            i = wordEnd;
+        for (int l = page.firstLine; l < end; l++) {
+            const LineInfo& line = lines[l];
+            if (line.start + line.length > text.length()) break;
+            gfx.setCursor(x, y + line.y);
+            gfx.write((const uint8_t*)buf + line.start, line.length);
         }
     }
 };
@@ -0,0 +1,220 @@
+#include "ZipIndex.h"
+#include <LittleFS.h>
+
+namespace {
+    const uint32_t INDEX_MAGIC = 0x495A5248; // "HRZI"
+    const uint16_t INDEX_VERSION = 1;
+
+    struct IndexHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t entrySize;
+        uint32_t sourceSize;
+        uint32_t sourceMtime;
+        uint32_t entryCount;
+        uint32_t slotCount;
+    };
+
+    const uint32_t LOCAL_HEADER_SIG = 0x04034b50;
+    const size_t LOCAL_HEADER_SIZE = 30;
+    const size_t MAX_NAME_LEN = 256;
+    // Enough for the 65535 entries of a non-zip64 archive at our load factor;
+    // anything larger in a sidecar is corruption, not a book
+    const uint32_t MAX_SLOT_COUNT = 1u << 17;
+
+    uint16_t readLE16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+    uint32_t readLE32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+}
+
+ZipIndex::ZipIndex() {
+    slots = nullptr;
+    slotCount = 0;
+    entryCount = 0;
+}
+
+ZipIndex::~ZipIndex() {
+    clear();
+}
+
+void ZipIndex::clear() {
+    if (slots) {
+        free(slots);
+        slots = nullptr;
+    }
+    slotCount = 0;
+    entryCount = 0;
+}
+
+uint32_t ZipIndex::hashName(const char* name) {
+    uint32_t h = 2166136261u;
+    while (*name) {
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+bool ZipIndex::allocate(uint32_t count) {
+    clear();
+    // Keep load factor <= 2/3 so probes stay short
+    uint32_t want = count + count / 2 + 1;
+    if (want > MAX_SLOT_COUNT) {
+        Serial.printf("Zip index: %u entries is more than a book should have\n", count);
+        return false;
+    }
+    slotCount = 16;
+    while (slotCount < want) slotCount <<= 1;
+
+    size_t bytes = slotCount * sizeof(ZipIndexEntry);
+    slots = (ZipIndexEntry*)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+    if (!slots) slots = (ZipIndexEntry*)malloc(bytes);
+    if (!slots) {
+        slotCount = 0;
+        return false;
+    }
+    for (uint32_t i = 0; i < slotCount; i++) slots[i].method = EMPTY_SLOT;
+    return true;
+}
+
+void ZipIndex::insert(const ZipIndexEntry& entry) {
+    uint32_t mask = slotCount - 1;
+    uint32_t i = entry.nameHash & mask;
+    while (slots[i].method != EMPTY_SLOT) i = (i + 1) & mask;
+    slots[i] = entry;
+    entryCount++;
+}
+
+bool ZipIndex::build(mz_zip_archive* zip) {
+    mz_uint count = mz_zip_reader_get_num_files(zip);
+    if (!allocate(count)) return false;
+
+    mz_zip_archive_file_stat stat;
+    for (mz_uint i = 0; i < count; i++) {
+        if (!mz_zip_reader_file_stat(zip, i, &stat)) continue;
+        ZipIndexEntry entry;
+        entry.nameHash = hashName(stat.m_filename);
+        entry.localHeaderOffset = (uint32_t)stat.m_local_header_ofs;
+        entry.compSize = (uint32_t)stat.m_comp_size;
+        entry.uncompSize = (uint32_t)stat.m_uncomp_size;
+        entry.crc32 = stat.m_crc32;
+        entry.method = stat.m_method;
+        entry.reserved = 0;
+        insert(entry);
+    }
+    return true;
+}
+
+bool ZipIndex::load(const String& path, uint32_t sourceSize, uint32_t sourceMtime) {
+    clear();
+    File f = LittleFS.open(path, "r");
+    if (!f) return false;
+
+    IndexHeader header;
+    bool ok = f.read((uint8_t*)&header, sizeof(header)) == sizeof(header)
+        && header.magic == INDEX_MAGIC
+        && header.version == INDEX_VERSION
+        && header.entrySize == sizeof(ZipIndexEntry)
+        && header.sourceSize == sourceSize
+        && header.sourceMtime == sourceMtime
+        && header.slotCount > 0 && header.slotCount <= MAX_SLOT_COUNT
+        && (header.slotCount & (header.slotCount - 1)) == 0
+        && header.entryCount < header.slotCount
+        && f.size() == sizeof(header) + (size_t)header.slotCount * sizeof(ZipIndexEntry);
+
+    if (ok) {
+        size_t bytes = header.slotCount * sizeof(ZipIndexEntry);
+        slots = (ZipIndexEntry*)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+        if (!slots) slots = (ZipIndexEntry*)malloc(bytes);
+        ok = slots && f.read((uint8_t*)slots, bytes) == bytes;
+    }
+    f.close();
+
+    if (ok) {
+        // The occupied slots must match the header, which leaves at least one
+        // empty slot to end every probe of a damaged table
+        uint32_t used = 0;
+        for (uint32_t i = 0; i < header.slotCount; i++) {
+            if (slots[i].method != EMPTY_SLOT) used++;
+        }
+        ok = used == header.entryCount;
+    }
+
+    if (!ok) {
+        clear();
+        return false;
+    }
+    slotCount = header.slotCount;
+    entryCount = header.entryCount;
+    return true;
+}
+
+bool ZipIndex::save(const String& path, uint32_t sourceSize, uint32_t sourceMtime) const {
+    if (!slots) return false;
+
+    // Write to a temp file and rename so a power cut never leaves a torn index
+    String tmpPath = path + ".tmp";
+    File f = LittleFS.open(tmpPath, "w");
+    if (!f) return false;
+
+    IndexHeader header;
+    header.magic = INDEX_MAGIC;
+    header.version = INDEX_VERSION;
+    header.entrySize = sizeof(ZipIndexEntry);
+    header.sourceSize = sourceSize;
+    header.sourceMtime = sourceMtime;
+    header.entryCount = entryCount;
+    header.slotCount = slotCount;
+
+    size_t bytes = slotCount * sizeof(ZipIndexEntry);
+    bool ok = f.write((const uint8_t*)&header, sizeof(header)) == sizeof(header)
+        && f.write((const uint8_t*)slots, bytes) == bytes;
+    f.close();
+
+    if (!ok) {
+        LittleFS.remove(tmpPath);
+        return false;
+    }
+    LittleFS.remove(path);
+    return LittleFS.rename(tmpPath, path);
+}
+
+const ZipIndexEntry* ZipIndex::locate(const char* name, BlockCache& source, uint32_t& dataOffset) const {
+    if (!slots) return nullptr;
+
+    uint32_t hash = hashName(name);
+    size_t nameLen = strlen(name);
+    uint32_t mask = slotCount - 1;
+
+    // Bounded as well, so no table can make the probe loop forever
+    uint32_t i = hash & mask;
+    for (uint32_t probes = 0; probes < slotCount && slots[i].method != EMPTY_SLOT; probes++, i = (i + 1) & mask) {
+        const ZipIndexEntry& entry = slots[i];
+        if (entry.nameHash != hash) continue;
+
+        // Confirm against the local header (also gives us the data offset)
+        uint8_t header[LOCAL_HEADER_SIZE + MAX_NAME_LEN];
+        size_t want = LOCAL_HEADER_SIZE + (nameLen < MAX_NAME_LEN ? nameLen : MAX_NAME_LEN);
+        if (source.read(entry.localHeaderOffset, header, want) != want) continue;
+        if (readLE32(header) != LOCAL_HEADER_SIG) continue;
+
+        uint16_t headerNameLen = readLE16(header + 26);
+        uint16_t extraLen = readLE16(header + 28);
+        if (headerNameLen != nameLen) continue;
+
+        // The first MAX_NAME_LEN bytes of the name came with the header; a
+        // longer name is read on and compared piece by piece
+        uint8_t* piece = header + LOCAL_HEADER_SIZE;
+        bool same = true;
+        for (size_t done = 0; same && done < nameLen; ) {
+            size_t n = nameLen - done < MAX_NAME_LEN ? nameLen - done : MAX_NAME_LEN;
+            if (done > 0) same = source.read(entry.localHeaderOffset + LOCAL_HEADER_SIZE + done, piece, n) == n;
+            same = same && memcmp(piece, name + done, n) == 0;
+            done += n;
+        }
+        if (!same) continue;
+
+        dataOffset = entry.localHeaderOffset + LOCAL_HEADER_SIZE + headerNameLen + extraLen;
+        return &entry;
+    }
+    return nullptr;
+}
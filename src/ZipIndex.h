@@ -0,0 +1,54 @@
+#ifndef ZIP_INDEX_H
+#define ZIP_INDEX_H
+
+#include <Arduino.h>
+#include "miniz.h"
+#include "BlockCache.h"
+
+// One central-directory record, reduced to what extraction needs
+struct ZipIndexEntry {
+    uint32_t nameHash;          // FNV-1a of the full entry name
+    uint32_t localHeaderOffset;
+    uint32_t compSize;
+    uint32_t uncompSize;
+    uint32_t crc32;
+    uint16_t method;            // 0 = stored, 8 = deflate, EMPTY_SLOT = unused
+    uint16_t reserved;
+};
+
+// Hash table over a zip's central directory, persisted as a binary sidecar
+// ("<book>.idx") keyed by the book's size and mtime. Repeat opens load the
+// table instead of re-parsing the central directory, and names resolve with
+// a single probe plus a check against the entry's local header.
+class ZipIndex {
+public:
+    static const uint16_t EMPTY_SLOT = 0xFFFF;
+
+    ZipIndex();
+    ~ZipIndex();
+
+    // Build from an initialised miniz reader
+    bool build(mz_zip_archive* zip);
+    // Load a sidecar; fails if missing, corrupt or written for a different file
+    bool load(const String& path, uint32_t sourceSize, uint32_t sourceMtime);
+    bool save(const String& path, uint32_t sourceSize, uint32_t sourceMtime) const;
+    void clear();
+
+    int getEntryCount() const { return entryCount; }
+
+    // Resolve a name to its entry and the offset of its compressed data.
+    // Hash candidates are confirmed against the local header name.
+    const ZipIndexEntry* locate(const char* name, BlockCache& source, uint32_t& dataOffset) const;
+
+    static uint32_t hashName(const char* name);
+
+private:
+    ZipIndexEntry* slots;
+    uint32_t slotCount;     // power of two
+    uint32_t entryCount;
+
+    bool allocate(uint32_t count);
+    void insert(const ZipIndexEntry& entry);
+};
+
+#endif
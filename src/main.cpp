@@ -2,22 +2,58 @@
 #include <M5Unified.h>
 #include <M5GFX.h>
 #include <vector>
+#include <algorithm>
 #include <LittleFS.h>
 #include <ArduinoJson.h>
+#include <freertos/timers.h>
+#include <freertos/event_groups.h>
 #include "EpubReader.h"
 #include "Paginator.h"
+#include "CompiledBook.h"
+#include "PageCache.h"
+#include "BookIndex.h"
+#include "CancelToken.h"
+#include "BookmarkJournal.h"
+#include "LibraryCatalog.h"
+#include "CoverCache.h"
+#include "ZipIndex.h"
 
 
 // --- Constants ---
 #define COLOR_BG TFT_WHITE
 #define COLOR_TEXT TFT_BLACK
+// Convert opened books into a pre-processed .hrb file in the background
+#define ENABLE_BOOK_COMPILE 1
 
 // --- Globals ---
 EpubReader reader;
-std::vector<String> epubFiles;
-int currentFileIndex = 0;
+CompiledBook compiledBook; // Used instead of reader when the book has been compiled
+PageCache pageCache;       // Layouts of an uncompiled book, kept across opens
+String currentBook = "";   // File name of the open book
 int currentChapterIndex = 0;
 
+// Library: the catalog and covers stay on flash and home reads one screen of
+// them at a time. libraryTask brings both up to date after boot, so boot
+// doesn't wait on the directory. libraryMutex guards library; covers is
+// written only by libraryTask, and its reads check the slot's key.
+LibraryCatalog library;
+CoverCache covers;         // Pre-dithered cover thumbnails for the grid view
+M5Canvas thumbCanvas;      // 4bpp grey sprite a thumbnail is read straight into
+SemaphoreHandle_t libraryMutex = NULL;
+volatile bool libraryUpdating = false;
+volatile bool libraryChanged = false; // set by libraryTask; home redraws
+// Home view, persisted in /settings.json. HOME_RECENT lists the last
+// RECENT_LIMIT books with a bookmark, newest first.
+enum HomeSort { HOME_BY_TITLE, HOME_BY_AUTHOR, HOME_RECENT, HOME_SORT_COUNT };
+HomeSort homeSort = HOME_BY_TITLE;
+bool homeGrid = false;     // Covers instead of the list
+const size_t RECENT_LIMIT = BookmarkJournal::RECENT_SIZE;
+std::vector<int> recentRecords; // Catalog records of HOME_RECENT, UI task only
+const int GRID_COLUMNS = 3;
+const int GRID_ROWS = 3;
+const int LIST_ROW_HEIGHT = 65;
+int currentFileIndex = 0;  // Selection: position in the home view
+
 // State Machine
 enum AppState {
     STATE_HOME,
@@ -34,70 +70,302 @@ AppState currentState = STATE_HOME;
 // Text Buffer & Pagination
 String currentTextBuffer = "";
 std::vector<PageInfo> currentPages;
+std::vector<LineInfo> currentLines; // Line table the pages index into
+// Progressive layout: the chapter's first pages are laid out up front and the
+// rest in backgroundLayoutTask while the user reads. pagesMutex guards
+// currentPages/currentLines/layoutComplete while that task appends to them.
+SemaphoreHandle_t pagesMutex = NULL;
+// LAYOUT_PAGES_BIT is set whenever the background task adds pages (under
+// pagesMutex) or ends; a page wait clears it under the same lock before it
+// checks, so no step is missed. There is one waiter at a time: the loader
+// during a load, the UI otherwise. LAYOUT_EXITED_BIT is set as the task ends.
+// layoutRunning belongs to whoever starts and stops the task: it stays set
+// until stopBackgroundLayout has seen the task end.
+EventGroupHandle_t layoutEvents = NULL;
+const EventBits_t LAYOUT_PAGES_BIT = 1 << 0;
+const EventBits_t LAYOUT_EXITED_BIT = 1 << 1;
+PageLayouter backgroundLayout;
+volatile bool layoutComplete = true;
+volatile bool layoutRunning = false;
+volatile bool layoutCancel = false;
 int textScrollOffset = 0; 
 bool textRedrawNeeded = false;
 float currentTextSize = 4.0; // Default Size (Medium)
 
 // Async Task Globals
-enum AsyncOp { OP_OPEN, OP_LOAD_CHAPTER };
-AsyncOp currentOp;
+// One long-lived loader task takes commands from loaderQueue. Every command
+// but OP_PREFETCH/OP_FLUSH_BOOKMARK posts a LoaderResult to loaderDoneQueue, which loop() waits
+// on, so the UI wakes as soon as a load is done.
+// Each UI command bumps loadGeneration: whatever the loader is running for an
+// older generation stops at its next check, and only the newest publishes.
+enum AsyncOp { OP_OPEN, OP_LOAD_CHAPTER, OP_RESIZE, OP_PREFETCH, OP_CLOSE, OP_FLUSH_BOOKMARK };
+struct LoaderCommand {
+    AsyncOp op;
+    int chapter;            // OP_LOAD_CHAPTER
+    int page;               // OP_LOAD_CHAPTER: page to open at
+    float fraction;         // OP_LOAD_CHAPTER: or a fraction of the chapter's text, if >= 0
+    uint32_t generation;
+    unsigned long queuedUs;
+};
+struct LoaderResult {
+    AsyncOp op;
+    bool success;
+    uint32_t generation;
+    unsigned long doneUs;
+};
+volatile uint32_t loadGeneration = 0;
+int pendingChapter = -1; // Chapter the newest OP_LOAD_CHAPTER goes to
+const int LOADER_QUEUE_LENGTH = 8;
+QueueHandle_t loaderQueue = NULL;
+QueueHandle_t loaderDoneQueue = NULL;
+AsyncOp currentOp; // Last command the UI is waiting on
 String targetOpenFile = "";
-int targetLoadChapterIndex = -1;
-volatile bool operationSuccess = false;
-volatile bool operationComplete = false;
+// OP_RESIZE: the UI only sets targetTextSize; the loader owns currentTextSize.
+// Another SIZE tap mid-layout queues a fresh resize from the same anchor.
+float targetTextSize = 4.0;
+int resizeAnchor = 0;
+unsigned long operationStartMs = 0;
+
+// Background book compile. The loader and the indexer both start it, so
+// compileMutex guards compileTargetFile and compileRunning: one compile at a time.
+SemaphoreHandle_t compileMutex = NULL;
+String compileTargetFile = "";
+bool compileRunning = false;
+
+// Reading positions of every book (replaces /bookmarks.json, imported once)
+BookmarkJournal bookmarks;
+// Page turns only update pendingMark. The loader writes it to the journal
+// once the reader has been idle for BOOKMARK_FLUSH_MS (every turn restarts
+// the timer, so a reading streak costs one write), and straight away on
+// chapter changes, going home and power off.
+const uint32_t BOOKMARK_FLUSH_MS = 30000;
+SemaphoreHandle_t bookmarkMutex = NULL; // Guards pendingBook/pendingMark/bookmarkDirty
+SemaphoreHandle_t journalMutex = NULL;  // Serializes bookmarks (loader vs power off)
+TimerHandle_t bookmarkTimer = NULL;
+String pendingBook = "";
+BookmarkJournal::Bookmark pendingMark;
+bool bookmarkDirty = false;
+int bookmarkSaves = 0;  // positions recorded this session
+int bookmarkWrites = 0; // of which reached flash
+
+// Book-wide page numbers. bookIndex is read by the UI and written by the
+// indexer task, both under pagesMutex; the indexer is its only writer while running.
+BookIndex bookIndex;
+String indexTargetFile = "";
+volatile bool indexRunning = false;
+// Nonzero while stopBookIndex waits; a counter so the indexer's reads and
+// layout can watch it through a CancelToken
+volatile uint32_t indexCancel = 0;
+int skipTargetPage = -1; // Book-wide page picked in the skip panel (-1: chapter-local skipping)
+
+// Rough book progress before (or without) a page index: chapterStarts[i] is
+// the size of the chapters before i, from the zip's uncompressed sizes (a
+// compiled book keeps them in its chapter table, so percentages don't move
+// once a book is compiled). Set at open under pagesMutex.
+std::vector<uint32_t> chapterStarts;
+int skipTargetPercent = -1; // Percent picked in the skip panel (-1: none)
+
+// Guards reader/compiledBook between the loader, prefetch and UI tasks
+SemaphoreHandle_t bookMutex = NULL;
+// Bumped (under bookMutex) whenever the open book is closed, to drop stale background results
+volatile int bookGeneration = 0;
+
+// Chapter prefetch: neighbouring chapters are loaded and laid out while the
+// user reads, so crossing a chapter boundary is a buffer swap. Chapter-sized
+// Strings/vectors are above the internal-RAM threshold and land in PSRAM.
+struct ChapterSlot {
+    int chapter = -1;
+    float textSize = 0;
+    String text;
+    std::vector<PageInfo> pages;
+    std::vector<LineInfo> lines;
+};
+const int PREFETCH_SLOTS = 2;
+ChapterSlot prefetchSlots[PREFETCH_SLOTS];
+SemaphoreHandle_t prefetchMutex = NULL; // Guards prefetchSlots and prefetchQueued
+bool prefetchQueued = false; // an OP_PREFETCH is waiting in or being run by the loader
+int prefetchHits = 0;
+int prefetchMisses = 0;
+
+// Page pre-rendering: the current page and its neighbours are kept rendered
+// in full-screen 8-bit PSRAM canvases, filled while the reader is idle, so a
+// page turn is a single push. Canvases are keyed by page index and layout
+// version; layoutVersion is bumped whenever currentPages is replaced.
+struct PageCanvas {
+    M5Canvas canvas;
+    int layout = -1;
+    int page = -1;
+};
+const int PAGE_CANVASES = 3;
+PageCanvas pageCanvases[PAGE_CANVASES];
+bool pageCanvasesReady = false;
+// Bumped only under pagesMutex, together with the page change it stands for
+volatile int layoutVersion = 0;
+
+// EPD refresh policy: page turns use the fast waveform; a full quality refresh
+// clears the ghosting every fullRefreshEvery turns and on chapter changes.
+// fullRefreshEvery == 1 refreshes every turn in quality mode. Persisted in /settings.json.
+const int REFRESH_CHOICES[] = { 1, 5, 10, 20 };
+const int REFRESH_CHOICE_COUNT = 4;
+int fullRefreshEvery = 10;
+epd_mode_t defaultEpdMode = epd_mode_t::epd_quality;
+int turnsSinceFullRefresh = 0;
+int lastRefreshChapter = -1;
+int fullRefreshCount = 0;
+int fastRefreshCount = 0;
+bool refreshPending = false;      // waiting for the panel to finish, to log the time
+bool refreshPendingFull = false;
+unsigned long refreshStartMs = 0;
 
 // Helpers
-void saveBookmark() {
-    if (epubFiles.empty() || currentFileIndex >= epubFiles.size()) return;
-    
-    String filename = epubFiles[currentFileIndex];
+
+// Text offset of the first character on the current page: the reading
+// position, independent of text size and layout
+int currentPageOffset() {
+    xSemaphoreTake(pagesMutex, portMAX_DELAY);
+    int offset = textScrollOffset < currentPages.size() ? currentPages[textScrollOffset].start : 0;
+    xSemaphoreGive(pagesMutex);
+    return offset;
+}
+
+void saveSettings() {
     JsonDocument doc;
-    
-    File f = LittleFS.open("/bookmarks.json", "r");
-    if (f) {
-        deserializeJson(doc, f);
-        f.close();
-    }
-    
-    doc[filename]["chapter"] = currentChapterIndex;
-    doc[filename]["page"] = textScrollOffset;
-    doc[filename]["size"] = currentTextSize;
-    
-    f = LittleFS.open("/bookmarks.json", "w");
+    doc["fullRefreshEvery"] = fullRefreshEvery;
+    doc["homeGrid"] = homeGrid;
+    doc["homeSort"] = (int)homeSort;
+    File f = LittleFS.open("/settings.json", "w");
     if (f) {
         serializeJson(doc, f);
         f.close();
-        Serial.printf("DEBUG: Save Bookmark [%s] -> Ch:%d, Pg:%d, Sz:%.1f\n", filename.c_str(), currentChapterIndex, textScrollOffset, currentTextSize);
     } else {
-        Serial.println("DEBUG: Failed to open bookmarks.json for writing!");
+        Serial.println("DEBUG: Failed to open settings.json for writing!");
     }
 }
 
-
-void loadBookmark(String filename, int& chapter, int& page, float& size) {
-    File f = LittleFS.open("/bookmarks.json", "r");
-    if (!f) {
-        Serial.println("DEBUG: No bookmarks.json found");
-        return;
-    }
+void loadSettings() {
+    File f = LittleFS.open("/settings.json", "r");
+    if (!f) return;
     
     JsonDocument doc;
     deserializeJson(doc, f);
     f.close();
     
-    if (doc.containsKey(filename)) {
-        chapter = doc[filename]["chapter"] | 0;
-        page = doc[filename]["page"] | 0;
-        size = doc[filename]["size"] | 4.0;
-        Serial.printf("DEBUG: Load Bookmark [%s] -> Ch:%d, Pg:%d, Sz:%.1f\n", filename.c_str(), chapter, page, size);
+    homeGrid = doc["homeGrid"] | homeGrid;
+    int sort = doc["homeSort"] | (int)homeSort;
+    if (sort >= 0 && sort < HOME_SORT_COUNT) homeSort = (HomeSort)sort;
+    int every = doc["fullRefreshEvery"] | fullRefreshEvery;
+    for (int i = 0; i < REFRESH_CHOICE_COUNT; i++) {
+        if (REFRESH_CHOICES[i] == every) fullRefreshEvery = every;
+    }
+    Serial.printf("DEBUG: Settings: full refresh every %d turns\n", fullRefreshEvery);
+}
+
+// Records the reading position in RAM; flushBookmark() persists it
+void saveBookmark() {
+    if (currentBook.length() == 0) return;
+    
+    BookmarkJournal::Bookmark mark;
+    mark.chapter = currentChapterIndex;
+    mark.offset = currentPageOffset();
+    mark.page = textScrollOffset;
+    mark.textSize = currentTextSize;
+    
+    xSemaphoreTake(bookmarkMutex, portMAX_DELAY);
+    pendingBook = currentBook;
+    pendingMark = mark;
+    bookmarkDirty = true;
+    bookmarkSaves++;
+    xSemaphoreGive(bookmarkMutex);
+    xTimerReset(bookmarkTimer, 0);
+}
+
+// Writes the pending position to the journal, if there is one. Runs on the
+// loader, except at power off.
+void flushBookmark() {
+    xSemaphoreTake(journalMutex, portMAX_DELAY);
+    xSemaphoreTake(bookmarkMutex, portMAX_DELAY);
+    bool dirty = bookmarkDirty;
+    String filename = pendingBook;
+    BookmarkJournal::Bookmark mark = pendingMark;
+    bookmarkDirty = false;
+    xSemaphoreGive(bookmarkMutex);
+    
+    if (dirty) {
+        unsigned long startUs = micros();
+        size_t bytesBefore = bookmarks.getBytesWritten();
+        if (bookmarks.put(filename, mark)) {
+            if (bookmarks.getBytesWritten() != bytesBefore) bookmarkWrites++;
+            Serial.printf("DEBUG: Save Bookmark [%s] -> Ch:%d, Off:%d (Pg:%d), Sz:%.1f in %lu us, %d bytes written (%d saves, %d flash writes)\n",
+                          filename.c_str(), mark.chapter, mark.offset, mark.page, mark.textSize, micros() - startUs,
+                          bookmarks.getBytesWritten() - bytesBefore, bookmarkSaves, bookmarkWrites);
+        } else {
+            Serial.println("DEBUG: Failed to write bookmark journal!");
+        }
+    }
+    xSemaphoreGive(journalMutex);
+}
+
+// Hands the flush to the loader, behind whatever it is doing
+void requestBookmarkFlush() {
+    xTimerStop(bookmarkTimer, 0);
+    LoaderCommand cmd = { OP_FLUSH_BOOKMARK, -1, 0, -1, loadGeneration, micros() };
+    // Queue full: the timer gets another go later
+    if (xQueueSend(loaderQueue, &cmd, 0) != pdTRUE) xTimerReset(bookmarkTimer, 0);
+}
+
+// Runs on the timer service task, which must not touch flash
+void bookmarkTimerCallback(TimerHandle_t timer) {
+    requestBookmarkFlush();
+}
+
+
+// offset is left at -1 for bookmarks that only have a page index
+void loadBookmark(String filename, int& chapter, int& offset, int& page, float& size) {
+    flushBookmark(); // A position still pending may be this book's
+    BookmarkJournal::Bookmark mark;
+    xSemaphoreTake(journalMutex, portMAX_DELAY);
+    bool found = bookmarks.get(filename, mark);
+    xSemaphoreGive(journalMutex);
+    if (found) {
+        chapter = mark.chapter;
+        offset = mark.offset;
+        page = mark.page;
+        size = mark.textSize;
+        Serial.printf("DEBUG: Load Bookmark [%s] -> Ch:%d, Off:%d, Pg:%d, Sz:%.1f\n", filename.c_str(), chapter, offset, page, size);
     } else {
         Serial.printf("DEBUG: No bookmark for [%s]\n", filename.c_str());
     }
 }
 
+// One-time move of /bookmarks.json into the journal
+void importLegacyBookmarks() {
+    File f = LittleFS.open("/bookmarks.json", "r");
+    if (!f) return;
+    JsonDocument doc;
+    DeserializationError err = deserializeJson(doc, f);
+    f.close();
+    if (err) return;
+    
+    int imported = 0;
+    for (JsonPair book : doc.as<JsonObject>()) {
+        BookmarkJournal::Bookmark mark;
+        mark.chapter = book.value()["chapter"] | 0;
+        mark.offset = book.value()["offset"] | -1;
+        mark.page = book.value()["page"] | 0;
+        mark.textSize = book.value()["size"] | 4.0;
+        bookmarks.put(book.key().c_str(), mark);
+        imported++;
+    }
+    if (bookmarks.compact()) {
+        LittleFS.remove("/bookmarks.json");
+        Serial.printf("Bookmarks: imported %d books from bookmarks.json\n", imported);
+    }
+}
+
 
 void powerOffSequence() {
     saveBookmark();
+    flushBookmark();
     M5.Display.fillScreen(COLOR_BG);
     
     // Draw Splash Image if exists
@@ -115,24 +383,571 @@ void powerOffSequence() {
     M5.Power.powerOff();
 }
 
-void recalculatePages() {
-
+// Text area used for layout (width minus margins, height minus header)
+void getTextViewport(int& w, int& h) {
     int margin = 10;
-    int w = M5.Display.width() - (margin * 2);
-    int h = M5.Display.height() - 60; // Space for header
-    currentPages = Paginator::paginate(currentTextBuffer, 0, 0, w, h, currentTextSize);
+    w = M5.Display.width() - (margin * 2);
+    h = M5.Display.height() - 60; // Space for header
+}
+
+int chapterCount() {
+    if (compiledBook.isOpen()) return compiledBook.getChapterCount();
+    return reader.getChapters().size();
+}
+
+// Caller must hold bookMutex
+String readChapterText(int chapter, const CancelToken& cancel = CancelToken()) {
+    if (compiledBook.isOpen()) return compiledBook.loadChapterText(chapter, cancel);
+    return reader.getChapterContent(chapter, cancel);
+}
+
+// Layout from the compiled book or the page cache, if either has it. Caller must hold bookMutex.
+bool loadStoredLayout(int chapter, float textSize, std::vector<PageInfo>& pages, std::vector<LineInfo>& lines) {
+    // Compiled books carry layouts for every text size
+    int sizeIdx = CompiledBook::sizeIndex(textSize);
+    if (compiledBook.isOpen() && sizeIdx >= 0) {
+        pages = compiledBook.loadPages(chapter, sizeIdx, lines);
+        return true;
+    }
+
+    int w, h;
+    getTextViewport(w, h);
+    return pageCache.load(chapter, textSize, w, h, pages, lines);
+}
+
+// Lays out a chapter's text on gfx page by page, checking cancel between
+// pages. Needs no lock: text is the caller's own copy. False if cancelled.
+bool layoutChapterText(const String& text, float textSize, std::vector<PageInfo>& pages, std::vector<LineInfo>& lines,
+                       lgfx::LovyanGFX& gfx, const CancelToken& cancel) {
+    int w, h;
+    getTextViewport(w, h);
+    PageLayouter layouter;
+    layouter.begin(text, w, h, textSize, gfx);
+    while (!cancel.isCancelled() && layouter.step(pages, lines)) {}
+    return !cancel.isCancelled();
+}
+
+// Pages laid out so far
+int laidOutPageCount() {
+    xSemaphoreTake(pagesMutex, portMAX_DELAY);
+    int count = currentPages.size();
+    xSemaphoreGive(pagesMutex);
+    return count;
+}
+
+// Blocks until page is laid out (or the chapter turns out shorter). Returns whether it exists.
+bool waitForPage(int page) {
+    unsigned long startMs = millis();
+    while (true) {
+        xSemaphoreTake(pagesMutex, portMAX_DELAY);
+        xEventGroupClearBits(layoutEvents, LAYOUT_PAGES_BIT);
+        bool have = page < currentPages.size();
+        bool done = layoutComplete;
+        xSemaphoreGive(pagesMutex);
+        if (have || done) {
+            if (millis() - startMs > 0) Serial.printf("Layout: waited %lu ms for Pg %d\n", millis() - startMs, page + 1);
+            return have;
+        }
+        xEventGroupWaitBits(layoutEvents, LAYOUT_PAGES_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+    }
+}
+
+// Blocks until the page holding text offset is laid out (or the chapter ends first). Returns that page.
+int waitForOffset(int offset) {
+    while (true) {
+        xSemaphoreTake(pagesMutex, portMAX_DELAY);
+        xEventGroupClearBits(layoutEvents, LAYOUT_PAGES_BIT);
+        bool have = !currentPages.empty() && currentPages.back().start + currentPages.back().length > offset;
+        bool done = layoutComplete;
+        int page = Paginator::pageForOffset(currentPages, offset);
+        xSemaphoreGive(pagesMutex);
+        if (have || done) return page;
+        xEventGroupWaitBits(layoutEvents, LAYOUT_PAGES_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+    }
 }
 
-// Unified Task for heavy stack operations
-void asyncLoaderTask(void * parameter) {
-    Serial.println(">>> asyncLoaderTask: Started");
-    operationSuccess = false;
+void backgroundLayoutTask(void * parameter) {
+    int chapter = currentChapterIndex;
+    float size = currentTextSize;
+    unsigned long startMs = millis();
     
-    if (currentOp == OP_OPEN) {
-        // 1. Try normal path
+    bool more = true;
+    while (more && !layoutCancel) {
+        xSemaphoreTake(pagesMutex, portMAX_DELAY);
+        more = backgroundLayout.step(currentPages, currentLines);
+        if (!more) {
+            layoutComplete = true;
+            // The header total changes from "..." to the page count
+            layoutVersion++;
+        }
+        xEventGroupSetBits(layoutEvents, LAYOUT_PAGES_BIT);
+        xSemaphoreGive(pagesMutex);
+        taskYIELD();
+    }
+    
+    if (layoutComplete) {
+        Serial.printf("Layout: Ch %d finished in background (%d pages, %lu ms)\n", chapter + 1, currentPages.size(), millis() - startMs);
+        int w, h;
+        getTextViewport(w, h);
+        xSemaphoreTake(bookMutex, portMAX_DELAY);
+        pageCache.store(chapter, size, w, h, currentPages, currentLines);
+        xSemaphoreGive(bookMutex);
+    }
+    
+    xEventGroupSetBits(layoutEvents, LAYOUT_PAGES_BIT | LAYOUT_EXITED_BIT);
+    vTaskDelete(NULL);
+}
+
+// Stops background layout of the current chapter. Must be called before the
+// current text or pages are replaced, and without holding bookMutex
+// (the task takes it to store the finished layout).
+void stopBackgroundLayout() {
+    if (!layoutRunning) return;
+    layoutCancel = true;
+    // Returns at once if the task already finished on its own
+    xEventGroupWaitBits(layoutEvents, LAYOUT_EXITED_BIT, pdTRUE, pdTRUE, portMAX_DELAY);
+    layoutCancel = false;
+    layoutRunning = false;
+}
+
+// Lays out the current chapter far enough to show the page holding text
+// offset anchor, and moves textScrollOffset to that page; the rest continues
+// in the background. Caller must hold bookMutex and have stopped any
+// background layout. Gives up between pages if cancel fires.
+// Lays out into local tables and only takes pagesMutex to publish them, so the
+// UI's page queries aren't held up by the layout.
+void recalculatePages(int anchor, const CancelToken& cancel = CancelToken()) {
+    unsigned long startMs = millis();
+    std::vector<PageInfo> pages;
+    std::vector<LineInfo> lines;
+    bool stored = loadStoredLayout(currentChapterIndex, currentTextSize, pages, lines);
+    
+    if (!stored) {
+        int w, h;
+        getTextViewport(w, h);
+        backgroundLayout.begin(currentTextBuffer, w, h, currentTextSize, M5.Display);
+        while ((pages.empty() || pages.back().start + pages.back().length <= anchor)
+               && !cancel.isCancelled() && backgroundLayout.step(pages, lines)) {}
+    }
+    if (cancel.isCancelled()) {
+        // A newer command replaces these pages; don't start the background pass
+        Serial.printf("Paginate cancelled after %lu ms\n", millis() - startMs);
+        return;
+    }
+    
+    xSemaphoreTake(pagesMutex, portMAX_DELAY);
+    currentPages = std::move(pages);
+    currentLines = std::move(lines);
+    layoutComplete = stored || backgroundLayout.isDone();
+    textScrollOffset = Paginator::pageForOffset(currentPages, anchor);
+    int pageCount = currentPages.size();
+    bool complete = layoutComplete;
+    layoutVersion++;
+    xSemaphoreGive(pagesMutex);
+    
+    if (!complete) {
+        layoutRunning = true;
+        xEventGroupClearBits(layoutEvents, LAYOUT_EXITED_BIT);
+        // Same stack as the other tasks that write flash: it stores the finished layout
+        xTaskCreate(backgroundLayoutTask, "Layout", 32768, NULL, 1, NULL);
+    } else if (!stored) {
+        int w, h;
+        getTextViewport(w, h);
+        pageCache.store(currentChapterIndex, currentTextSize, w, h, currentPages, currentLines);
+    }
+    Serial.printf("Paginated %d pages%s in %lu ms\n", pageCount, complete ? "" : " (rest in background)", millis() - startMs);
+}
+
+// Fill currentTextBuffer/currentPages for currentChapterIndex
+void loadCurrentChapter(int anchor, const CancelToken& cancel = CancelToken()) {
+    currentTextBuffer = readChapterText(currentChapterIndex, cancel);
+    if (!cancel.isCancelled()) recalculatePages(anchor, cancel);
+}
+
+// --- Chapter Prefetch ---
+
+// Next neighbour of the current chapter not yet held at the current size (-1 if none).
+// Caller must hold prefetchMutex.
+int nextPrefetchTarget() {
+    // Forward first: it's the common reading direction
+    int candidates[2] = { currentChapterIndex + 1, currentChapterIndex - 1 };
+    for (int c : candidates) {
+        if (c < 0 || c >= chapterCount()) continue;
+        bool held = false;
+        for (int i = 0; i < PREFETCH_SLOTS; i++) {
+            if (prefetchSlots[i].chapter == c && prefetchSlots[i].textSize == currentTextSize) held = true;
+        }
+        if (!held) return c;
+    }
+    return -1;
+}
+
+// Slot to overwrite: one that isn't a neighbour of the current chapter, else the farthest.
+// Caller must hold prefetchMutex.
+int prefetchVictimSlot() {
+    int victim = 0;
+    int victimDistance = -1;
+    for (int i = 0; i < PREFETCH_SLOTS; i++) {
+        const ChapterSlot& slot = prefetchSlots[i];
+        int distance = slot.chapter < 0 || slot.textSize != currentTextSize ? 1000000 : abs(slot.chapter - currentChapterIndex);
+        if (distance > victimDistance) {
+            victim = i;
+            victimDistance = distance;
+        }
+    }
+    return victim;
+}
+
+// Loads and lays out one neighbour chapter on the loader task; measure is an
+// off-screen canvas. Any UI command cancels it (it is queued again after the
+// command). Returns false once there's nothing left to prefetch or it was cancelled.
+bool prefetchOneChapter(M5Canvas& measure) {
+    {
+        xSemaphoreTake(prefetchMutex, portMAX_DELAY);
+        int chapter = nextPrefetchTarget();
+        float size = currentTextSize;
+        if (chapter < 0) {
+            prefetchQueued = false;
+            xSemaphoreGive(prefetchMutex);
+            return false;
+        }
+        xSemaphoreGive(prefetchMutex);
+        
+        unsigned long startMs = millis();
+        ChapterSlot fresh;
+        fresh.chapter = chapter;
+        fresh.textSize = size;
+        CancelToken cancel(loadGeneration, loadGeneration);
+        
+        // bookMutex only for the read; the layout runs on our own copy of the text
+        xSemaphoreTake(bookMutex, portMAX_DELAY);
+        int generation = bookGeneration;
+        bool bookOpen = chapter < chapterCount();
+        bool stored = bookOpen && loadStoredLayout(chapter, size, fresh.pages, fresh.lines);
+        if (bookOpen) fresh.text = readChapterText(chapter, cancel);
+        xSemaphoreGive(bookMutex);
+        
+        if (bookOpen && !stored && layoutChapterText(fresh.text, size, fresh.pages, fresh.lines, measure, cancel)) {
+            int w, h;
+            getTextViewport(w, h);
+            xSemaphoreTake(bookMutex, portMAX_DELAY);
+            if (generation == bookGeneration) pageCache.store(chapter, size, w, h, fresh.pages, fresh.lines);
+            xSemaphoreGive(bookMutex);
+        }
+        int pageCount = fresh.pages.size();
+        
+        xSemaphoreTake(prefetchMutex, portMAX_DELAY);
+        if (!bookOpen || generation != bookGeneration || cancel.isCancelled()) {
+            // Book was closed underneath us, or the user moved on
+            if (cancel.isCancelled()) Serial.printf("Prefetch: Ch %d dropped after %lu ms\n", chapter + 1, millis() - startMs);
+            prefetchQueued = false;
+            xSemaphoreGive(prefetchMutex);
+            return false;
+        }
+        prefetchSlots[prefetchVictimSlot()] = std::move(fresh);
+        xSemaphoreGive(prefetchMutex);
+        Serial.printf("Prefetch: Ch %d ready (%d pages) in %lu ms\n", chapter + 1, pageCount, millis() - startMs);
+    }
+    return true;
+}
+
+// Queue a prefetch on the loader if none is pending (it re-checks targets until none are left)
+void startPrefetch() {
+    xSemaphoreTake(prefetchMutex, portMAX_DELAY);
+    bool start = !prefetchQueued && nextPrefetchTarget() >= 0;
+    if (start) prefetchQueued = true;
+    xSemaphoreGive(prefetchMutex);
+    
+    if (start) {
+        LoaderCommand cmd = { OP_PREFETCH, -1, 0, -1, loadGeneration, micros() };
+        if (xQueueSend(loaderQueue, &cmd, 0) != pdTRUE) {
+            xSemaphoreTake(prefetchMutex, portMAX_DELAY);
+            prefetchQueued = false;
+            xSemaphoreGive(prefetchMutex);
+        }
+    }
+}
+
+void clearPrefetch() {
+    xSemaphoreTake(prefetchMutex, portMAX_DELAY);
+    for (int i = 0; i < PREFETCH_SLOTS; i++) prefetchSlots[i] = ChapterSlot();
+    xSemaphoreGive(prefetchMutex);
+}
+
+// Swap a prefetched chapter into the reader. The chapter being left takes its
+// slot, so turning straight back is a swap as well.
+bool takePrefetchedChapter(int chapter) {
+    stopBackgroundLayout();
+    bool hit = false;
+    xSemaphoreTake(prefetchMutex, portMAX_DELAY);
+    for (int i = 0; i < PREFETCH_SLOTS; i++) {
+        ChapterSlot& slot = prefetchSlots[i];
+        if (slot.chapter == chapter && slot.textSize == currentTextSize) {
+            xSemaphoreTake(pagesMutex, portMAX_DELAY);
+            std::swap(currentTextBuffer, slot.text);
+            std::swap(currentPages, slot.pages);
+            std::swap(currentLines, slot.lines);
+            // A chapter left half laid out can't be kept for turning back
+            slot.chapter = layoutComplete ? currentChapterIndex : -1;
+            layoutComplete = true;
+            layoutVersion++;
+            xSemaphoreGive(pagesMutex);
+            currentChapterIndex = chapter;
+            hit = true;
+            break;
+        }
+    }
+    xSemaphoreGive(prefetchMutex);
+    
+    if (hit) prefetchHits++;
+    else prefetchMisses++;
+    Serial.printf("Prefetch: Ch %d %s (%d hits / %d misses)\n", chapter + 1, hit ? "hit" : "miss", prefetchHits, prefetchMisses);
+    return hit;
+}
+
+void bookCompileTask(void * parameter) {
+    xSemaphoreTake(compileMutex, portMAX_DELAY);
+    String bookPath = compileTargetFile;
+    xSemaphoreGive(compileMutex);
+    Serial.printf(">>> bookCompileTask: Compiling %s\n", bookPath.c_str());
+    int w, h;
+    getTextViewport(w, h);
+    
+    // Measure on an off-screen canvas (no pixel buffer needed) so the
+    // display's text size isn't changed under the UI task
+    M5Canvas measure(&M5.Display);
+    CompiledBook::compile(bookPath, w, h, measure);
+    
+    xSemaphoreTake(compileMutex, portMAX_DELAY);
+    compileRunning = false;
+    xSemaphoreGive(compileMutex);
+    Serial.println(">>> bookCompileTask: Done.");
+    vTaskDelete(NULL);
+}
+
+void startBookCompile(const String& bookPath) {
+#if ENABLE_BOOK_COMPILE
+    int w, h;
+    getTextViewport(w, h);
+    xSemaphoreTake(compileMutex, portMAX_DELAY);
+    bool start = !compileRunning && !CompiledBook::isCompiled(bookPath, w, h);
+    if (start) {
+        compileTargetFile = bookPath;
+        compileRunning = true;
+    }
+    xSemaphoreGive(compileMutex);
+    // Lowest priority: only runs while the reader is idle
+    if (start) xTaskCreate(bookCompileTask, "Compiler", 65536, NULL, tskIDLE_PRIORITY, NULL);
+#endif
+}
+
+// Lays out every chapter missing from the book index at the current size,
+// reusing and filling the page cache, and saves the index as it goes, then
+// hands over to the book compile so the two don't compete for the CPU.
+void bookIndexTask(void * parameter) {
+    M5Canvas measure(&M5.Display);
+    float size = currentTextSize;
+    int sizeIndex = CompiledBook::sizeIndex(size);
+    int w, h;
+    getTextViewport(w, h);
+    unsigned long startMs = millis();
+    int chapters = bookIndex.getChapterCount();
+    int built = 0;
+    CancelToken cancel(indexCancel, 0);
+    
+    for (int c = 0; c < chapters && !cancel.isCancelled(); c++) {
+        if (bookIndex.getPageCount(sizeIndex, c) >= 0) continue;
+        
+        // Chapters already read at this size have their layout in the page cache
+        std::vector<PageInfo> pageList;
+        std::vector<LineInfo> lines;
+        xSemaphoreTake(bookMutex, portMAX_DELAY);
+        bool stored = loadStoredLayout(c, size, pageList, lines);
+        String text = stored ? String() : readChapterText(c, cancel);
+        xSemaphoreGive(bookMutex);
+        if (cancel.isCancelled()) break;
+        
+        if (!stored) {
+            // Page by page, so a stop doesn't wait for a long chapter to finish
+            if (!layoutChapterText(text, size, pageList, lines, measure, cancel)) break;
+            // Opening the chapter later then skips the layout as well
+            xSemaphoreTake(bookMutex, portMAX_DELAY);
+            pageCache.store(c, size, w, h, pageList, lines);
+            xSemaphoreGive(bookMutex);
+        }
+        int pages = pageList.size();
+        
+        xSemaphoreTake(pagesMutex, portMAX_DELAY);
+        bookIndex.setPageCount(sizeIndex, c, pages);
+        int known = bookIndex.getKnownCount(sizeIndex);
+        xSemaphoreGive(pagesMutex);
+        Serial.printf("Index: Ch %d = %d pages (%d/%d chapters, %lu ms)\n", c + 1, pages, known, chapters, millis() - startMs);
+        
+        // Save every few chapters so an interrupted build resumes
+        if (++built % 8 == 0) bookIndex.save();
+    }
+    if (built % 8 != 0) bookIndex.save();
+    
+    bool complete = bookIndex.isComplete(sizeIndex);
+    if (complete) {
+        // Headers gain the book-wide page number
+        xSemaphoreTake(pagesMutex, portMAX_DELAY);
+        layoutVersion++;
+        xSemaphoreGive(pagesMutex);
+        Serial.printf("Index: %d pages at size %.1f, built in %lu ms\n", bookIndex.getTotalPages(sizeIndex), size, millis() - startMs);
+    }
+    // indexRunning stays set until the hand-over is done, so stopBookIndex
+    // doesn't return while the compile for this book is still being started
+    if (complete && !cancel.isCancelled()) startBookCompile(indexTargetFile);
+    indexRunning = false;
+    vTaskDelete(NULL);
+}
+
+// Stops the indexer. Like stopBackgroundLayout, not to be called with bookMutex held.
+void stopBookIndex() {
+    if (!indexRunning) return;
+    indexCancel = 1;
+    while (indexRunning) delay(1);
+    indexCancel = 0;
+}
+
+// Fills the book index for the current size: from the chapter table of a
+// compiled book, otherwise from "<book>.hpx" plus the indexer for whatever is
+// missing. Called by the loader (holding bookMutex) after an open or resize.
+void startBookIndex(const String& bookPath) {
+    int sizeIndex = CompiledBook::sizeIndex(currentTextSize);
+    int w, h;
+    getTextViewport(w, h);
+    
+    xSemaphoreTake(pagesMutex, portMAX_DELAY);
+    bool opening = !bookIndex.isOpen();
+    if (opening) bookIndex.open(bookPath, chapterCount(), w, h);
+    if (opening && compiledBook.isOpen()) {
+        for (int s = 0; s < CompiledBook::SIZE_COUNT; s++) {
+            for (int c = 0; c < bookIndex.getChapterCount(); c++) bookIndex.setPageCount(s, c, compiledBook.getPageCount(c, s));
+        }
+    }
+    bool complete = sizeIndex < 0 || bookIndex.isComplete(sizeIndex);
+    xSemaphoreGive(pagesMutex);
+    
+    if (complete) {
+        if (!compiledBook.isOpen()) startBookCompile(bookPath);
+        return;
+    }
+    indexTargetFile = bookPath;
+    indexRunning = true;
+    // Lowest priority: only runs while the reader is idle
+    xTaskCreate(bookIndexTask, "Indexer", 32768, NULL, tskIDLE_PRIORITY, NULL);
+}
+
+// Book-wide index of the current page, or -1 while the index is incomplete
+int currentGlobalPage() {
+    int sizeIndex = CompiledBook::sizeIndex(currentTextSize);
+    xSemaphoreTake(pagesMutex, portMAX_DELAY);
+    int page = bookIndex.isComplete(sizeIndex) ? bookIndex.getFirstPage(sizeIndex, currentChapterIndex) + textScrollOffset : -1;
+    xSemaphoreGive(pagesMutex);
+    return page;
+}
+
+// Caller must hold bookMutex
+void measureBookProgress() {
+    std::vector<uint32_t> starts;
+    if (compiledBook.isOpen()) {
+        uint32_t total = 0;
+        for (int c = 0; c < compiledBook.getChapterCount(); c++) {
+            starts.push_back(total);
+            total += compiledBook.getChapterSourceSize(c);
+        }
+        starts.push_back(total);
+    } else {
+        starts = reader.getChapterStarts();
+    }
+    xSemaphoreTake(pagesMutex, portMAX_DELAY);
+    chapterStarts = std::move(starts);
+    xSemaphoreGive(pagesMutex);
+}
+
+// Percent through the book at a text offset of the current chapter.
+// Caller must hold pagesMutex.
+int bookPercent(int offset) {
+    int c = currentChapterIndex;
+    if (c + 1 >= (int)chapterStarts.size() || chapterStarts.back() == 0) return 0;
+    float inChapter = currentTextBuffer.length() > 0 ? (float)offset / currentTextBuffer.length() : 0;
+    float done = chapterStarts[c] + inChapter * (chapterStarts[c + 1] - chapterStarts[c]);
+    return (int)(done * 100 / chapterStarts.back());
+}
+
+// Chapter and fraction of its text at percent of the book; false without sizes
+bool locatePercent(int percent, int& chapter, float& fraction) {
+    xSemaphoreTake(pagesMutex, portMAX_DELAY);
+    int chapters = (int)chapterStarts.size() - 1;
+    bool ok = chapters > 0 && chapterStarts.back() > 0;
+    if (ok) {
+        uint32_t target = (uint64_t)chapterStarts.back() * percent / 100;
+        // Last chapter starting at or before target (empty chapters share a start)
+        int lo = 0, hi = chapters - 1;
+        chapter = 0;
+        while (lo <= hi) {
+            int mid = (lo + hi) / 2;
+            if (chapterStarts[mid] <= target) {
+                chapter = mid;
+                lo = mid + 1;
+            } else {
+                hi = mid - 1;
+            }
+        }
+        uint32_t size = chapterStarts[chapter + 1] - chapterStarts[chapter];
+        fraction = size > 0 && target < chapterStarts[chapter + 1] ? (float)(target - chapterStarts[chapter]) / size : 0;
+    }
+    xSemaphoreGive(pagesMutex);
+    return ok;
+}
+
+// Closes the open book and drops everything derived from it. Runs on the
+// loader (OP_CLOSE), since it waits for the background tasks and bookMutex.
+void closeBook() {
+    stopBackgroundLayout();
+    stopBookIndex();
+    xSemaphoreTake(bookMutex, portMAX_DELAY);
+    reader.close();
+    compiledBook.close();
+    pageCache.close();
+    xSemaphoreTake(pagesMutex, portMAX_DELAY);
+    bookIndex.close();
+    xSemaphoreGive(pagesMutex);
+    bookGeneration++;
+    xSemaphoreGive(bookMutex);
+    clearPrefetch();
+}
+
+// Runs an open, chapter load or resize on the loader task. Returns false if
+// it failed or was cancelled (a newer command is queued behind it then).
+bool runLoaderCommand(const LoaderCommand& cmd) {
+    if (cmd.op == OP_CLOSE) {
+        closeBook();
+        return true;
+    }
+    
+    CancelToken cancel(loadGeneration, cmd.generation);
+    bool operationSuccess = false;
+    stopBackgroundLayout();
+    // Chapter loads share the book with the indexer; opens and resizes change what it indexes
+    if (cmd.op != OP_LOAD_CHAPTER) stopBookIndex();
+    xSemaphoreTake(bookMutex, portMAX_DELAY);
+    
+    if (cmd.op == OP_OPEN) {
+        int w, h;
+        getTextViewport(w, h);
+        
+        // 0. Pre-processed copy: no unzip or layout needed
         Serial.printf("Task: Opening %s\n", targetOpenFile.c_str());
-        if (reader.open(targetOpenFile.c_str())) {
+        if (compiledBook.open(targetOpenFile, w, h)) {
             operationSuccess = true;
+        }
+        // 1. Try normal path
+        else if (reader.open(targetOpenFile.c_str())) {
+            operationSuccess = true;
+            pageCache.open(targetOpenFile);
         } else {
             // 2. Try prefix
             String alt = "/littlefs/" + targetOpenFile;
@@ -140,6 +955,8 @@ void asyncLoaderTask(void * parameter) {
             Serial.printf("Task: Retrying %s\n", alt.c_str());
             if (reader.open(alt.c_str())) {
                 operationSuccess = true;
+                // Layouts are cached beside the file that actually opened
+                pageCache.open(alt);
             }
         }
         
@@ -148,76 +965,303 @@ void asyncLoaderTask(void * parameter) {
             
             // Load bookmark
             int savedCh = 0;
+            int savedOffset = -1;
             int savedPg = 0;
             float savedSize = currentTextSize;
-            loadBookmark(epubFiles[currentFileIndex], savedCh, savedPg, savedSize);
+            loadBookmark(currentBook, savedCh, savedOffset, savedPg, savedSize);
             
             currentChapterIndex = savedCh;
             currentTextSize = savedSize;
+            measureBookProgress();
             
             Serial.printf("Task: Loading Ch %d from Bookmark\n", currentChapterIndex);
-            currentTextBuffer = reader.getChapterContent(currentChapterIndex);
-            recalculatePages(); 
-            textScrollOffset = savedPg;
-            Serial.printf("Task: Repaginated. Total Pages: %d, Restoring Pg: %d\n", currentPages.size(), textScrollOffset);
-            if (textScrollOffset >= currentPages.size()) {
-                Serial.println("Task: Restored Page out of bounds, resetting to 0");
-                textScrollOffset = 0;
+            if (savedOffset >= 0) {
+                loadCurrentChapter(savedOffset, cancel);
+            } else {
+                // Old bookmark: only the page index at the saved size is known
+                loadCurrentChapter(0, cancel);
+                if (!cancel.isCancelled()) textScrollOffset = waitForPage(savedPg) ? savedPg : 0;
             }
+            Serial.printf("Task: Repaginated. Pages so far: %d, Restoring Pg: %d\n", laidOutPageCount(), textScrollOffset);
+            
+            if (!cancel.isCancelled()) startBookIndex(targetOpenFile);
         }
 
 
         
-    } else if (currentOp == OP_LOAD_CHAPTER) {
-        currentChapterIndex = targetLoadChapterIndex;
-        currentTextBuffer = reader.getChapterContent(currentChapterIndex);
-        recalculatePages();
-        textScrollOffset = 0; // Reset to start of new chapter
+    } else if (cmd.op == OP_LOAD_CHAPTER) {
+        currentChapterIndex = cmd.chapter;
+        if (cmd.fraction >= 0) {
+            // Percent jump: the position is only known relative to the text
+            currentTextBuffer = readChapterText(currentChapterIndex, cancel);
+            if (!cancel.isCancelled()) recalculatePages((int)(cmd.fraction * currentTextBuffer.length()), cancel);
+        } else {
+            loadCurrentChapter(0, cancel); // Start of the new chapter
+            if (cmd.page > 0 && !cancel.isCancelled()) textScrollOffset = waitForPage(cmd.page) ? cmd.page : 0;
+        }
         operationSuccess = true; 
+    } else if (cmd.op == OP_RESIZE) {
+        currentTextSize = targetTextSize;
+        recalculatePages(resizeAnchor, cancel);
+        operationSuccess = true;
+        if (!cancel.isCancelled()) startBookIndex(targetOpenFile);
     }
 
 
+    xSemaphoreGive(bookMutex);
+
+    if (cancel.isCancelled()) {
+        Serial.printf("Task: op %d cancelled (generation %u, now %u)\n", cmd.op, cmd.generation, loadGeneration);
+        return false;
+    }
     if (operationSuccess) {
         textRedrawNeeded = true;
     } else {
 
         Serial.println("Task: Operation Failed.");
     }
+    return operationSuccess;
+}
+
+// The loader: created once in setup() and fed through loaderQueue
+void loaderTask(void * parameter) {
+    // Off-screen measuring for prefetch layout, so the display's text state isn't touched
+    M5Canvas measure(&M5.Display);
+    LoaderCommand cmd;
     
-    operationComplete = true;
-    Serial.println(">>> asyncLoaderTask: Done.");
-    vTaskDelete(NULL);
+    while (true) {
+        xQueueReceive(loaderQueue, &cmd, portMAX_DELAY);
+        
+        if (cmd.op == OP_PREFETCH) {
+            // One chapter at a time, requeued behind anything the UI asked for meanwhile
+            if (prefetchOneChapter(measure) && xQueueSend(loaderQueue, &cmd, 0) != pdTRUE) {
+                xSemaphoreTake(prefetchMutex, portMAX_DELAY);
+                prefetchQueued = false;
+                xSemaphoreGive(prefetchMutex);
+            }
+            continue;
+        }
+        if (cmd.op == OP_FLUSH_BOOKMARK) {
+            flushBookmark();
+            continue;
+        }
+        
+        if (cmd.generation != loadGeneration) {
+            Serial.printf(">>> Loader: op %d skipped, superseded before it started\n", cmd.op);
+            continue;
+        }
+        
+        Serial.printf(">>> Loader: op %d started %lu us after queueing\n", cmd.op, micros() - cmd.queuedUs);
+        LoaderResult result;
+        result.op = cmd.op;
+        result.generation = cmd.generation;
+        result.success = runLoaderCommand(cmd);
+        result.doneUs = micros();
+        // Only the newest command reports back
+        if (cmd.generation == loadGeneration) xQueueSend(loaderDoneQueue, &result, portMAX_DELAY);
+        Serial.println(">>> Loader: Done.");
+    }
 }
 
-void startAsyncOp(AsyncOp op) {
+// Queues a UI command; anything older still running or queued is cancelled
+void startAsyncOp(AsyncOp op, int chapter = -1, int page = 0, float fraction = -1) {
     currentOp = op;
-    operationComplete = false;
-    operationSuccess = false;
     currentState = STATE_LOADING;
+    operationStartMs = millis();
+    if (op == OP_LOAD_CHAPTER) pendingChapter = chapter;
     
-    M5.Display.fillScreen(COLOR_BG);
-    M5.Display.setCursor(M5.Display.width()/2, M5.Display.height()/2);
-    M5.Display.setTextSize(3);
-    if (op == OP_OPEN) M5.Display.drawCenterString("Opening...", M5.Display.width()/2, M5.Display.height()/2, &fonts::FreeSansBold9pt7b);
-    else M5.Display.drawCenterString("Loading...", M5.Display.width()/2, M5.Display.height()/2, &fonts::FreeSansBold9pt7b);
-
-    xTaskCreate(asyncLoaderTask, "Loader", 65536, NULL, 1, NULL);
+    if (op != OP_RESIZE) {
+        // For resizes the menu stays up so SIZE can be tapped again while laying out
+        M5.Display.fillScreen(COLOR_BG);
+        M5.Display.setCursor(M5.Display.width()/2, M5.Display.height()/2);
+        M5.Display.setTextSize(3);
+        String label = op == OP_OPEN ? "Opening..." : op == OP_CLOSE ? "Closing..." : "Loading Ch " + String(chapter + 1) + "...";
+        M5.Display.drawCenterString(label, M5.Display.width()/2, M5.Display.height()/2, &fonts::FreeSansBold9pt7b);
+        if (op != OP_CLOSE) M5.Display.drawCenterString("TAP TO CANCEL", M5.Display.width()/2, M5.Display.height()/2 + 60, &fonts::FreeSansBold9pt7b);
+    }
+    
+    LoaderCommand cmd = { op, chapter, page, fraction, ++loadGeneration, micros() };
+    xQueueSend(loaderQueue, &cmd, portMAX_DELAY);
 }
 
 // --- Helper Functions ---
 
-void listEpubFiles(File dir, std::vector<String>& list) {
-    while (true) {
-        File entry = dir.openNextFile();
-        if (!entry) break;
-        if (!entry.isDirectory()) {
-            String fname = String(entry.name());
-            if (fname.endsWith(".epub") || fname.endsWith(".EPUB")) {
-                list.push_back(fname); 
-            }
+// Runs once after boot at idle priority: opens only books added or changed
+// since the catalog was saved, then builds missing cover thumbnails
+void libraryTask(void * parameter) {
+    int scanned = library.update("/");
+    xSemaphoreTake(libraryMutex, portMAX_DELAY);
+    if (scanned >= 0 && library.install()) {
+        for (int32_t slot : library.getReleasedCovers()) covers.release(slot);
+        libraryChanged = true;
+    }
+    // Positions of deleted books would otherwise be kept (in RAM too) forever.
+    // An empty catalog is more likely a failed scan than an empty library.
+    if (library.getCount() > 0) {
+        xSemaphoreTake(journalMutex, portMAX_DELAY);
+        bookmarks.prune([](uint32_t bookId) { return library.findById(bookId) >= 0; });
+        xSemaphoreGive(journalMutex);
+    }
+    xSemaphoreGive(libraryMutex);
+    
+    int built = 0;
+    for (int i = 0; ; i++) {
+        LibraryCatalog::Entry book;
+        xSemaphoreTake(libraryMutex, portMAX_DELAY);
+        bool more = i < library.getCount() && library.read(i, book);
+        xSemaphoreGive(libraryMutex);
+        if (!more) break;
+        
+        // Extract, decode and slot write run unlocked so home keeps drawing meanwhile.
+        // A slot being written is keyed free until its pixels are in, so reads skip it.
+        bool needed = !(book.flags & (LibraryCatalog::FLAG_UNREADABLE | LibraryCatalog::FLAG_NO_COVER))
+            && !covers.isCurrent(book.coverSlot, book.bookId, book.fileSize, book.fileMtime);
+        if (!needed) continue;
+        int slot = covers.build("/" + String(book.name), book.coverSlot, book.bookId, book.fileSize, book.fileMtime);
+        if (slot >= 0 && slot != book.coverSlot) {
+            xSemaphoreTake(libraryMutex, portMAX_DELAY);
+            library.setCoverSlot(i, slot);
+            xSemaphoreGive(libraryMutex);
         }
-        entry.close();
+        built++;
     }
+    if (built > 0) libraryChanged = true;
+    
+    Serial.printf("Library: up to date, %d covers built\n", built);
+    libraryUpdating = false;
+    vTaskDelete(NULL);
+}
+
+// Caller holds libraryMutex
+void loadRecent() {
+    std::vector<uint32_t> ids;
+    xSemaphoreTake(journalMutex, portMAX_DELAY);
+    bookmarks.getRecent(ids, RECENT_LIMIT);
+    xSemaphoreGive(journalMutex);
+    // A bookmark not flushed yet is still the newest
+    xSemaphoreTake(bookmarkMutex, portMAX_DELAY);
+    if (bookmarkDirty) {
+        uint32_t id = ZipIndex::hashName(pendingBook.c_str());
+        ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+        ids.insert(ids.begin(), id);
+    }
+    xSemaphoreGive(bookmarkMutex);
+    recentRecords.clear();
+    for (uint32_t id : ids) {
+        int record = library.findById(id);
+        if (record >= 0) recentRecords.push_back(record);
+    }
+}
+
+// Number of books in the home view. Caller holds libraryMutex.
+int homeCount() {
+    return homeSort == HOME_RECENT ? recentRecords.size() : library.getCount();
+}
+
+// Book at a position of the home view. Caller holds libraryMutex.
+bool homeEntry(int position, LibraryCatalog::Entry& book) {
+    if (homeSort == HOME_RECENT) {
+        return position >= 0 && position < recentRecords.size() && library.read(recentRecords[position], book);
+    }
+    return library.readSorted(homeSort == HOME_BY_AUTHOR ? LibraryCatalog::SORT_AUTHOR : LibraryCatalog::SORT_TITLE, position, book);
+}
+
+// Opens the selected book of the home view
+void openSelectedBook() {
+    LibraryCatalog::Entry book;
+    xSemaphoreTake(libraryMutex, portMAX_DELAY);
+    bool found = homeEntry(currentFileIndex, book);
+    xSemaphoreGive(libraryMutex);
+    if (!found) return;
+    currentBook = book.name;
+    targetOpenFile = "/" + currentBook;
+    startAsyncOp(OP_OPEN);
+}
+
+// Cuts text to maxWidth at the current font and size, so rows don't wrap
+String fitWidth(String text, int maxWidth) {
+    if (M5.Display.textWidth(text) <= maxWidth) return text;
+    while (text.length() > 0 && M5.Display.textWidth(text + "...") > maxWidth) {
+        int cut = text.length() - 1;
+        while (cut > 0 && ((uint8_t)text[cut] & 0xC0) == 0x80) cut--; // Whole UTF-8 characters
+        text.remove(cut);
+    }
+    return text + "...";
+}
+
+// Cover grid: the page of GRID_COLUMNS x GRID_ROWS books holding the selection.
+// Caller holds libraryMutex.
+void drawHomeGrid() {
+    unsigned long startMs = millis();
+    int cellW = M5.Display.width() / GRID_COLUMNS;
+    int cellH = (M5.Display.height() - 50 - 50) / GRID_ROWS;
+    int perPage = GRID_COLUMNS * GRID_ROWS;
+    int first = (currentFileIndex / perPage) * perPage;
+    int drawn = 0;
+    
+    M5.Display.setTextSize(1);
+    LibraryCatalog::Entry book;
+    for (int i = first; i < first + perPage && homeEntry(i, book); i++) {
+        int x = ((i - first) % GRID_COLUMNS) * cellW + (cellW - CoverCache::THUMB_WIDTH) / 2;
+        int y = 50 + ((i - first) / GRID_COLUMNS) * cellH + 5;
+        
+        if (thumbCanvas.getBuffer() && covers.read(book.coverSlot, book.bookId, (uint8_t*)thumbCanvas.getBuffer())) {
+            thumbCanvas.pushSprite(&M5.Display, x, y);
+            drawn++;
+        } else {
+            // No cover (or not built yet): the title stands in for it
+            M5.Display.drawRect(x, y, CoverCache::THUMB_WIDTH, CoverCache::THUMB_HEIGHT, TFT_DARKGRAY);
+            M5.Display.setTextColor(COLOR_TEXT, COLOR_BG);
+            M5.Display.setCursor(x + 6, y + 10);
+            M5.Display.print(fitWidth(LibraryCatalog::displayTitle(book), CoverCache::THUMB_WIDTH - 12));
+        }
+        if (i == currentFileIndex) {
+            M5.Display.drawRect(x - 4, y - 4, CoverCache::THUMB_WIDTH + 8, CoverCache::THUMB_HEIGHT + 8, TFT_BLACK);
+            M5.Display.drawRect(x - 3, y - 3, CoverCache::THUMB_WIDTH + 6, CoverCache::THUMB_HEIGHT + 6, TFT_BLACK);
+        }
+        M5.Display.setTextColor(COLOR_TEXT, COLOR_BG);
+        M5.Display.setCursor(x, y + CoverCache::THUMB_HEIGHT + 8);
+        M5.Display.print(fitWidth(LibraryCatalog::displayTitle(book), CoverCache::THUMB_WIDTH));
+    }
+    Serial.printf("Home: %d covers drawn in %lu ms\n", drawn, millis() - startMs);
+}
+
+int listRowsPerPage() {
+    return (M5.Display.height() - 100) / LIST_ROW_HEIGHT;
+}
+
+// The page of rows holding the selection, read from the catalog only: no book
+// is opened and only these rows are read. Caller holds libraryMutex.
+void drawHomeList() {
+    unsigned long startMs = millis();
+    int rows = listRowsPerPage();
+    int first = (currentFileIndex / rows) * rows;
+    int y = 50;
+    LibraryCatalog::Entry book;
+    for (int i = first; i < first + rows && homeEntry(i, book); i++) {
+        bool selected = i == currentFileIndex;
+        uint16_t fg = selected ? TFT_WHITE : COLOR_TEXT;
+        uint16_t bg = selected ? TFT_BLACK : COLOR_BG;
+        if (selected) M5.Display.fillRect(0, y, M5.Display.width(), 60, TFT_BLACK); // Inverted
+        
+        M5.Display.setTextSize(3);
+        M5.Display.setTextColor(fg, bg);
+        M5.Display.setCursor(10, y + 5);
+        M5.Display.print(fitWidth(String(i + 1) + ". " + LibraryCatalog::displayTitle(book), M5.Display.width() - 20));
+        
+        M5.Display.setTextSize(2);
+        M5.Display.setTextColor(selected ? TFT_LIGHTGRAY : TFT_DARKGRAY, bg);
+        M5.Display.setCursor(10, y + 36);
+        if (book.flags & LibraryCatalog::FLAG_UNREADABLE) {
+            M5.Display.print("Unreadable");
+        } else {
+            String details = book.author[0] ? String(book.author) + " | " : "";
+            M5.Display.print(fitWidth(details + String(book.chapterCount) + " ch", M5.Display.width() - 20));
+        }
+        
+        y += LIST_ROW_HEIGHT;
+    }
+    Serial.printf("Home: rows %d-%d drawn in %lu ms\n", first + 1, first + rows, millis() - startMs);
 }
 
 void drawHome() {
@@ -232,47 +1276,145 @@ void drawHome() {
     M5.Display.setTextSize(2);
     M5.Display.setTextColor(TFT_DARKGRAY, COLOR_BG);
     M5.Display.drawRightString(String(bat) + "%", M5.Display.width() - 10, 12, &fonts::FreeSansBold9pt7b);
+    // Title bar: left half switches views, right half the sort
+    const char* sortLabels[HOME_SORT_COUNT] = { "[ TITLE ]", "[ AUTHOR ]", "[ RECENT ]" };
+    M5.Display.drawCenterString(homeGrid ? "[ LIST ]" : "[ COVERS ]", M5.Display.width() * 0.375, 12, &fonts::FreeSansBold9pt7b);
+    M5.Display.drawCenterString(sortLabels[homeSort], M5.Display.width() * 0.65, 12, &fonts::FreeSansBold9pt7b);
 
     M5.Display.drawFastHLine(0, 42, M5.Display.width(), TFT_BLACK);
 
+    xSemaphoreTake(libraryMutex, portMAX_DELAY);
+    if (homeSort == HOME_RECENT) loadRecent();
+    int count = homeCount();
+    if (currentFileIndex >= count) currentFileIndex = count > 0 ? count - 1 : 0;
+
     int y = 50;
-    if (epubFiles.empty()) {
+    if (count == 0) {
+        xSemaphoreGive(libraryMutex);
+        M5.Display.setTextSize(3);
+        M5.Display.setTextColor(COLOR_TEXT, COLOR_BG);
         M5.Display.setCursor(10, y);
-        M5.Display.println("No .epub files found!");
-        M5.Display.setTextSize(2);
-        M5.Display.setCursor(10, y + 40);
-        M5.Display.println("Please upload files to LittleFS:");
-        M5.Display.println("1. Put .epub in 'data'");
-        M5.Display.println("2. pio run -t uploadfs");
-        return;
-    }
-
-    for (int i = 0; i < epubFiles.size(); i++) {
-        if (i == currentFileIndex) {
-            M5.Display.fillRect(0, y, M5.Display.width(), 40, TFT_BLACK);
-            M5.Display.setTextColor(TFT_WHITE, TFT_BLACK); // Inverted
+        if (libraryUpdating) {
+            M5.Display.println("Updating library...");
+        } else if (homeSort == HOME_RECENT) {
+            M5.Display.println("No books read yet");
         } else {
-            M5.Display.setTextColor(COLOR_TEXT, COLOR_BG);
+            M5.Display.println("No .epub files found!");
+            M5.Display.setTextSize(2);
+            M5.Display.setCursor(10, y + 40);
+            M5.Display.println("Please upload files to LittleFS:");
+            M5.Display.println("1. Put .epub in 'data'");
+            M5.Display.println("2. pio run -t uploadfs");
         }
-        M5.Display.setCursor(10, y + 5);
-        M5.Display.printf("%d. %s", i + 1, epubFiles[i].c_str());
+    } else {
+        int perPage = homeGrid ? GRID_COLUMNS * GRID_ROWS : listRowsPerPage();
+        if (homeGrid) drawHomeGrid();
+        else drawHomeList();
+        xSemaphoreGive(libraryMutex);
         
-        y += 45;
-        if (y > M5.Display.height() - 40) break; 
+        M5.Display.setTextSize(2);
+        M5.Display.setTextColor(TFT_DARKGRAY, COLOR_BG);
+        M5.Display.drawString("< PREV", 10, M5.Display.height() - 30, &fonts::FreeSansBold9pt7b);
+        M5.Display.drawString("NEXT >", M5.Display.width() * 0.35, M5.Display.height() - 30, &fonts::FreeSansBold9pt7b);
+        String pageLabel = String(currentFileIndex / perPage + 1) + "/" + String((count + perPage - 1) / perPage);
+        M5.Display.setTextSize(1);
+        M5.Display.drawCenterString(pageLabel, M5.Display.width() / 2, M5.Display.height() - 58, &fonts::FreeSansBold9pt7b);
+        M5.Display.setTextSize(2);
     }
     
-    // Instructions
-    M5.Display.setTextSize(2);
-    M5.Display.setTextColor(TFT_DARKGRAY, COLOR_BG);
-    M5.Display.drawCenterString("UP/DN | SELECT", M5.Display.width()/2, M5.Display.height()-30, &fonts::FreeSansBold9pt7b);
-    
     // Power Button
     M5.Display.drawRightString("[ POWER OFF ]", M5.Display.width() - 10, M5.Display.height() - 30, &fonts::FreeSansBold9pt7b);
 }
 
 
+
+// --- Page Canvases ---
+
+void initPageCanvases() {
+    for (int i = 0; i < PAGE_CANVASES; i++) {
+        pageCanvases[i].canvas.setColorDepth(8);
+        pageCanvases[i].canvas.setPsram(true);
+        if (!pageCanvases[i].canvas.createSprite(M5.Display.width(), M5.Display.height())) {
+            // Not enough PSRAM: draw straight to the display instead
+            for (int j = 0; j < i; j++) pageCanvases[j].canvas.deleteSprite();
+            Serial.println("Page canvases unavailable, drawing directly");
+            return;
+        }
+    }
+    pageCanvasesReady = true;
+}
+
+// Full reader screen for a page of the current chapter. Returns the
+// layoutVersion of the pages it was drawn from.
+int renderReaderPage(lgfx::LovyanGFX& gfx, int page) {
+    gfx.fillScreen(COLOR_BG);
+    
+    // Header
+    gfx.setTextSize(2);
+    gfx.setTextColor(TFT_BLUE, COLOR_BG);
+    gfx.setCursor(5, 5);
+    xSemaphoreTake(pagesMutex, portMAX_DELAY);
+    // Page X of Y ("..." while the chapter is still being laid out)
+    if (layoutComplete) gfx.printf("Ch %d | Pg %d/%d", currentChapterIndex + 1, page + 1, currentPages.size());
+    else gfx.printf("Ch %d | Pg %d/...", currentChapterIndex + 1, page + 1);
+    // Page X of Y in the whole book, once the book index is complete
+    int sizeIndex = CompiledBook::sizeIndex(currentTextSize);
+    if (bookIndex.isComplete(sizeIndex)) {
+        gfx.printf(" | Book %d/%d", bookIndex.getFirstPage(sizeIndex, currentChapterIndex) + page + 1, bookIndex.getTotalPages(sizeIndex));
+    }
+    if (page < currentPages.size()) gfx.printf(" | %d%%", bookPercent(currentPages[page].start));
+    
+    // Draw Text using Paginator
+    if (page < currentPages.size()) {
+        int margin = 10;
+        Paginator::drawPage(currentTextBuffer, currentPages[page], currentLines, margin, 40, currentTextSize, COLOR_TEXT, gfx);
+    }
+    int version = layoutVersion;
+    xSemaphoreGive(pagesMutex);
+    return version;
+}
+
+int findPageCanvas(int page) {
+    for (int i = 0; i < PAGE_CANVASES; i++) {
+        if (pageCanvases[i].layout == layoutVersion && pageCanvases[i].page == page) return i;
+    }
+    return -1;
+}
+
+// Renders page into a canvas not holding the current page or a neighbour
+int renderPageCanvas(int page) {
+    int slot = 0;
+    for (int i = 0; i < PAGE_CANVASES; i++) {
+        const PageCanvas& pc = pageCanvases[i];
+        if (pc.layout != layoutVersion || abs(pc.page - textScrollOffset) > 1) {
+            slot = i;
+            break;
+        }
+    }
+    // Tag with the version the page was drawn from (background layout may bump it since)
+    pageCanvases[slot].layout = renderReaderPage(pageCanvases[slot].canvas, page);
+    pageCanvases[slot].page = page;
+    return slot;
+}
+
+// Idle work: render one missing neighbour of the current page (next first)
+void prerenderNeighbourPage() {
+    int pageCount = laidOutPageCount();
+    if (!pageCanvasesReady || pageCount == 0) return;
+    int candidates[2] = { textScrollOffset + 1, textScrollOffset - 1 };
+    for (int page : candidates) {
+        if (page < 0 || page >= pageCount || findPageCanvas(page) >= 0) continue;
+        unsigned long startUs = micros();
+        renderPageCanvas(page);
+        Serial.printf("Pre-rendered Pg %d in %lu us\n", page + 1, micros() - startUs);
+        return;
+    }
+}
+
 void drawReader() {
     if (!textRedrawNeeded) return;
+    unsigned long startMs = millis();
+    unsigned long startUs = micros();
     
     // Check page validity
     if (currentTextBuffer.length() == 0) {
@@ -284,31 +1426,131 @@ void drawReader() {
         return;
     }
     
-    if (textScrollOffset >= currentPages.size()) {
-       textScrollOffset = currentPages.size() - 1;
+    int pageCount = laidOutPageCount();
+    if (textScrollOffset >= pageCount) {
+       textScrollOffset = pageCount - 1;
        if (textScrollOffset < 0) textScrollOffset = 0;
     }
     
-    M5.Display.fillScreen(COLOR_BG);
-    
-    // Header
-    M5.Display.setTextSize(2);
-    M5.Display.setTextColor(TFT_BLUE, COLOR_BG);
-    M5.Display.setCursor(5, 5);
-    // Page X of Y
-    M5.Display.printf("Ch %d | Pg %d/%d", currentChapterIndex + 1, textScrollOffset + 1, currentPages.size());
+    // Raster: nothing to do if the page was pre-rendered while idle
+    int slot = pageCanvasesReady ? findPageCanvas(textScrollOffset) : -1;
+    bool prerendered = slot >= 0;
+    if (pageCanvasesReady && !prerendered) slot = renderPageCanvas(textScrollOffset);
+    unsigned long rasterUs = micros() - startUs;
     
-    // Draw Text using Paginator
-    if (currentPages.size() > 0) {
-        PageInfo p = currentPages[textScrollOffset];
-        int margin = 10;
-        int w = M5.Display.width() - (margin * 2);
-        int h = M5.Display.height() - 60;
-        
-        Paginator::drawPage(currentTextBuffer, p.start, p.length, margin, 40, w, h, currentTextSize, COLOR_TEXT);
+    // Refresh policy
+    bool full = currentChapterIndex != lastRefreshChapter || ++turnsSinceFullRefresh >= fullRefreshEvery;
+    if (full) {
+        turnsSinceFullRefresh = 0;
+        fullRefreshCount++;
+    } else {
+        fastRefreshCount++;
     }
+    lastRefreshChapter = currentChapterIndex;
+    M5.Display.setEpdMode(full ? epd_mode_t::epd_quality : epd_mode_t::epd_fast);
+    
+    unsigned long pushStartUs = micros();
+    if (slot >= 0) pageCanvases[slot].canvas.pushSprite(&M5.Display, 0, 0);
+    else renderReaderPage(M5.Display, textScrollOffset);
+    unsigned long pushUs = micros() - pushStartUs;
+    
+    // The mode is latched when the update is queued; menus and other screens keep the default
+    M5.Display.setEpdMode(defaultEpdMode);
+    refreshPending = true;
+    refreshPendingFull = full;
+    refreshStartMs = millis();
     
     textRedrawNeeded = false;
+    Serial.printf("Page drawn in %lu ms (raster %lu us%s, push %lu us)\n", millis() - startMs,
+                  rasterUs, prerendered ? " pre-rendered" : "", pushUs);
+}
+
+// Logs how long the panel took once the page turn's refresh has finished
+void checkRefreshDone() {
+    if (!refreshPending || M5.Display.displayBusy()) return;
+    refreshPending = false;
+    Serial.printf("EPD: %s refresh in %lu ms (%d full / %d fast)\n", refreshPendingFull ? "full" : "fast",
+                  millis() - refreshStartMs, fullRefreshCount, fastRefreshCount);
+}
+
+// --- Overlays ---
+// Menu and skip panels cover the top third of the page. The page under them
+// is still held in its page canvas, so closing an overlay pushes back just
+// that region instead of redrawing and refreshing the whole screen.
+
+int overlayPage = -1;
+int overlayLayout = -1;
+
+void openOverlay() {
+    overlayPage = textScrollOffset;
+    overlayLayout = layoutVersion;
+}
+
+// Panel-only updates while an overlay is up use the fast waveform
+void beginOverlayUpdate() {
+    M5.Display.setEpdMode(epd_mode_t::epd_fast);
+}
+
+void endOverlayUpdate() {
+    M5.Display.setEpdMode(defaultEpdMode);
+}
+
+void closeOverlay() {
+    currentState = STATE_READING;
+    int slot = -1;
+    if (pageCanvasesReady && textScrollOffset == overlayPage && layoutVersion == overlayLayout) {
+        slot = findPageCanvas(textScrollOffset);
+    }
+    if (slot < 0) {
+        // Page changed underneath (or nothing saved): full redraw
+        textRedrawNeeded = true;
+        return;
+    }
+    
+    unsigned long startMs = millis();
+    int h = M5.Display.height() / 3;
+    beginOverlayUpdate();
+    M5.Display.setClipRect(0, 0, M5.Display.width(), h);
+    pageCanvases[slot].canvas.pushSprite(&M5.Display, 0, 0);
+    M5.Display.clearClipRect();
+    endOverlayUpdate();
+    Serial.printf("Overlay closed: restored %dx%d in %lu ms\n", M5.Display.width(), h, millis() - startMs);
+}
+
+// Second menu row (settings); redrawn on its own when a setting changes
+void drawMenuSettingsRow() {
+    M5.Display.fillRect(1, 140, M5.Display.width() - 2, 60, TFT_LIGHTGREY);
+    M5.Display.setTextColor(TFT_BLACK, TFT_LIGHTGREY);
+    M5.Display.setTextSize(2);
+    String refresh = fullRefreshEvery == 1 ? "[ REFRESH: EVERY PAGE ]" : "[ FULL REFRESH: " + String(fullRefreshEvery) + " PAGES ]";
+    M5.Display.drawCenterString(refresh, M5.Display.width() * 0.5, 160, &fonts::FreeSansBold9pt7b);
+}
+
+// Size that follows size in the SIZE button's cycle
+float nextTextSize(float size) {
+    if (size <= 3.0) return 4.0;
+    if (size == 4.0) return 6.0;
+    return 3.0;
+}
+
+// Picks the next text size and (re)starts the resize around the current
+// reading position. Tapping again mid-layout just moves the target on.
+void requestResize() {
+    if (currentState == STATE_LOADING) {
+        targetTextSize = nextTextSize(targetTextSize);
+    } else {
+        resizeAnchor = currentPageOffset();
+        targetTextSize = nextTextSize(currentTextSize);
+    }
+    startAsyncOp(OP_RESIZE);
+    
+    int w = M5.Display.width();
+    beginOverlayUpdate();
+    M5.Display.fillRect(w / 2 + 2, 50, w / 4 - 4, 50, TFT_LIGHTGREY);
+    M5.Display.setTextColor(TFT_BLACK, TFT_LIGHTGREY);
+    M5.Display.setTextSize(2);
+    M5.Display.drawCenterString("[ SIZE " + String((int)targetTextSize) + "... ]", w * 0.62, 60, &fonts::FreeSansBold9pt7b);
+    endOverlayUpdate();
 }
 
 void drawMenu() {
@@ -339,9 +1581,27 @@ void drawMenu() {
     M5.Display.drawCenterString("[ OFF ]", M5.Display.width() * 0.85, 60, &fonts::FreeSansBold9pt7b);
     
     M5.Display.drawCenterString("MENU", M5.Display.width() * 0.5, 10, &fonts::FreeSansBold9pt7b);
+
+    drawMenuSettingsRow();
 }
 
 
+// Only the "Pg: N" area of the skip panel; the rest doesn't change while skipping
+void drawSkipPageNumber() {
+    M5.Display.fillRect(1, 45, M5.Display.width() - 2, 60, TFT_WHITE);
+    M5.Display.setTextColor(TFT_BLACK, TFT_WHITE);
+    M5.Display.setTextSize(3);
+    String label = "Pg: " + String(textScrollOffset + 1);
+    if (skipTargetPage >= 0) {
+        xSemaphoreTake(pagesMutex, portMAX_DELAY);
+        int total = bookIndex.getTotalPages(CompiledBook::sizeIndex(currentTextSize));
+        xSemaphoreGive(pagesMutex);
+        label = "Pg: " + String(skipTargetPage + 1) + " / " + String(total);
+    }
+    if (skipTargetPercent >= 0) label = "Go to: " + String(skipTargetPercent) + "%";
+    M5.Display.drawCenterString(label, M5.Display.width() * 0.5, 50, &fonts::FreeSansBold9pt7b);
+}
+
 void drawSkipPage() {
     int h = M5.Display.height() / 3;
     M5.Display.fillRect(0, 0, M5.Display.width(), h, TFT_WHITE);
@@ -349,10 +1609,21 @@ void drawSkipPage() {
     
     M5.Display.setTextColor(TFT_BLACK, TFT_WHITE);
     M5.Display.setTextSize(2);
-    M5.Display.drawCenterString("SKIP PAGE", M5.Display.width() * 0.5, 10, &fonts::FreeSansBold9pt7b);
+    if (skipTargetPage >= 0) {
+        M5.Display.drawCenterString("SKIP PAGE (BOOK)", M5.Display.width() * 0.5, 10, &fonts::FreeSansBold9pt7b);
+    } else {
+        // Only within the chapter until the book index is built
+        int sizeIndex = CompiledBook::sizeIndex(currentTextSize);
+        xSemaphoreTake(pagesMutex, portMAX_DELAY);
+        int known = bookIndex.getKnownCount(sizeIndex);
+        int chapters = bookIndex.getChapterCount();
+        xSemaphoreGive(pagesMutex);
+        String title = "SKIP PAGE (CHAPTER)";
+        if (chapters > 0) title += " - INDEXING " + String(known * 100 / chapters) + "%";
+        M5.Display.drawCenterString(title, M5.Display.width() * 0.5, 10, &fonts::FreeSansBold9pt7b);
+    }
     
-    M5.Display.setTextSize(3);
-    M5.Display.drawCenterString("Pg: " + String(textScrollOffset + 1), M5.Display.width() * 0.5, 50, &fonts::FreeSansBold9pt7b);
+    drawSkipPageNumber();
     
     M5.Display.setTextSize(2);
     M5.Display.drawCenterString("[ -10 ]", M5.Display.width() * 0.2, 110, &fonts::FreeSansBold9pt7b);
@@ -360,7 +1631,12 @@ void drawSkipPage() {
     M5.Display.drawCenterString("[ +1 ]", M5.Display.width() * 0.6, 110, &fonts::FreeSansBold9pt7b);
     M5.Display.drawCenterString("[ +10 ]", M5.Display.width() * 0.8, 110, &fonts::FreeSansBold9pt7b);
     
-    M5.Display.drawCenterString("TAP OUTSIDE TO CLOSE", M5.Display.width() * 0.5, 160, &fonts::FreeSansBold9pt7b);
+    M5.Display.drawCenterString("[ -10% ]", M5.Display.width() * 0.2, 170, &fonts::FreeSansBold9pt7b);
+    M5.Display.drawCenterString("[ -1% ]", M5.Display.width() * 0.4, 170, &fonts::FreeSansBold9pt7b);
+    M5.Display.drawCenterString("[ +1% ]", M5.Display.width() * 0.6, 170, &fonts::FreeSansBold9pt7b);
+    M5.Display.drawCenterString("[ +10% ]", M5.Display.width() * 0.8, 170, &fonts::FreeSansBold9pt7b);
+    
+    M5.Display.drawCenterString("TAP OUTSIDE TO CLOSE", M5.Display.width() * 0.5, 230, &fonts::FreeSansBold9pt7b);
 }
 
 
@@ -375,6 +1651,28 @@ void setup() {
     M5.Display.setRotation(0); 
     M5.Display.setTextSize(3); 
 
+    // Width tables for the reader sizes, before any task can lay out text
+    FontMetrics::prepare(M5.Display, CompiledBook::TEXT_SIZES, CompiledBook::SIZE_COUNT);
+    initPageCanvases();
+    thumbCanvas.setColorDepth(4);
+    if (thumbCanvas.createSprite(CoverCache::THUMB_WIDTH, CoverCache::THUMB_HEIGHT)) thumbCanvas.setPaletteGrayscale();
+    defaultEpdMode = M5.Display.getEpdMode();
+    
+    bookMutex = xSemaphoreCreateMutex();
+    prefetchMutex = xSemaphoreCreateMutex();
+    pagesMutex = xSemaphoreCreateMutex();
+    compileMutex = xSemaphoreCreateMutex();
+    layoutEvents = xEventGroupCreate();
+    bookmarkMutex = xSemaphoreCreateMutex();
+    journalMutex = xSemaphoreCreateMutex();
+    bookmarkTimer = xTimerCreate("Bookmark", pdMS_TO_TICKS(BOOKMARK_FLUSH_MS), pdFALSE, NULL, bookmarkTimerCallback);
+    loaderQueue = xQueueCreate(LOADER_QUEUE_LENGTH, sizeof(LoaderCommand));
+    loaderDoneQueue = xQueueCreate(LOADER_QUEUE_LENGTH, sizeof(LoaderResult));
+    // The one task creation that used to happen on every open and chapter load
+    unsigned long taskStartUs = micros();
+    xTaskCreate(loaderTask, "Loader", 65536, NULL, 1, NULL);
+    Serial.printf("Loader task created in %lu us\n", micros() - taskStartUs);
+
     // Initialize LittleFS
     M5.Display.println("Mounting LittleFS...");
     if (!LittleFS.begin(true)) { 
@@ -387,19 +1685,26 @@ void setup() {
         delay(500);
     }
 
-    File root = LittleFS.open("/");
-    if (!root) {
-        M5.Display.println("Failed to open root!");
-    } else {
-        listEpubFiles(root, epubFiles);
-        root.close();
-    }
+    loadSettings();
+    bookmarks.open("/bookmarks.hbj");
+    importLegacyBookmarks();
+
+    // The saved catalog is shown as is; libraryTask catches up with the
+    // directory and covers in the background
+    unsigned long libraryStartMs = millis();
+    library.open("/library.hlc");
+    covers.open("/covers.htc");
+    Serial.printf("Library: %d books opened in %lu ms\n", library.getCount(), millis() - libraryStartMs);
+    libraryMutex = xSemaphoreCreateMutex();
+    libraryUpdating = true;
+    xTaskCreate(libraryTask, "Library", 32768, NULL, tskIDLE_PRIORITY, NULL);
 
     drawHome();
 }
 
 void loop() {
     M5.update();
+    checkRefreshDone();
 
     int width = M5.Display.width();
     int height = M5.Display.height();
@@ -407,10 +1712,23 @@ void loop() {
     // Logic Dispatch
     if (currentState == STATE_LOADING) {
         // Spin while waiting for task
-        if (operationComplete) {
-            if (operationSuccess) {
+        LoaderResult result;
+        // Sleeps until the loader reports back; wakes every 50 ms to poll touch
+        bool done = xQueueReceive(loaderDoneQueue, &result, pdMS_TO_TICKS(50)) == pdTRUE
+            && result.generation == loadGeneration;
+        if (done && result.op == OP_CLOSE) {
+            currentState = STATE_HOME;
+            drawHome();
+        } else if (done) {
+            if (result.success) {
                 currentState = STATE_READING;
                 drawReader();
+                Serial.printf("Loader: completion-to-draw %lu us\n", micros() - result.doneUs);
+                Serial.printf("%s-to-first-page: %lu ms (%s)\n", currentOp == OP_OPEN ? "Open" : currentOp == OP_RESIZE ? "Resize" : "Chapter",
+                              millis() - operationStartMs, compiledBook.isOpen() ? "compiled" : "epub");
+                if (currentOp == OP_RESIZE || currentOp == OP_LOAD_CHAPTER) saveBookmark();
+                if (currentOp == OP_LOAD_CHAPTER) requestBookmarkFlush();
+                startPrefetch(); // Neighbours must be re-laid out at a new size
             } else {
                 M5.Display.fillScreen(COLOR_BG);
                 M5.Display.setCursor(10, height/2);
@@ -420,46 +1738,90 @@ void loop() {
                 currentState = STATE_HOME; // Fallback to home on error
                 drawHome();
             }
+        } else if (currentOp == OP_RESIZE && M5.Touch.getCount() > 0) {
+            // Menu is still up: SIZE again moves the resize on to the next size
+            auto t = M5.Touch.getDetail();
+            if (t.wasPressed() && t.y <= 130 && t.x >= width * 0.5 && t.x < width * 0.75) requestResize();
+        } else if ((currentOp == OP_OPEN || currentOp == OP_LOAD_CHAPTER) && M5.Touch.getCount() > 0) {
+            auto t = M5.Touch.getDetail();
+            if (t.wasPressed()) {
+                if (currentOp == OP_LOAD_CHAPTER && t.x > width * 0.75 && pendingChapter < chapterCount() - 1) {
+                    // Turning on past a chapter still loading: only the newest target gets loaded
+                    startAsyncOp(OP_LOAD_CHAPTER, pendingChapter + 1);
+                } else if (currentOp == OP_LOAD_CHAPTER && t.x < width * 0.25 && pendingChapter > 0) {
+                    startAsyncOp(OP_LOAD_CHAPTER, pendingChapter - 1);
+                } else if (t.x >= width * 0.25 && t.x <= width * 0.75) {
+                    // Cancel: back to the library
+                    startAsyncOp(OP_CLOSE);
+                }
+            }
         }
-        delay(100);
         return;
     }
 
     if (currentState == STATE_HOME) {
         if (M5.Touch.getCount() > 0) {
             auto t = M5.Touch.getDetail();
-            if (t.wasPressed()) {
-                if (t.y < height / 3) {
-                    // Up/Previous File
-                    currentFileIndex--;
-                    if (currentFileIndex < 0) currentFileIndex = epubFiles.size() - 1;
+            if (t.wasPressed() && t.y < 42) {
+                if (t.x < width / 2) homeGrid = !homeGrid;
+                else if (t.x < width * 0.8) homeSort = (HomeSort)((homeSort + 1) % HOME_SORT_COUNT);
+                currentFileIndex = 0;
+                saveSettings();
+                drawHome();
+            } else if (t.wasPressed() && t.y > height - 50) {
+                // Whole pages, wrapping
+                int perPage = homeGrid ? GRID_COLUMNS * GRID_ROWS : listRowsPerPage();
+                xSemaphoreTake(libraryMutex, portMAX_DELAY);
+                int count = homeCount();
+                xSemaphoreGive(libraryMutex);
+                if (t.x > width * 0.6) {
+                    powerOffSequence();
+                } else if (count > 0) {
+                    int pages = (count + perPage - 1) / perPage;
+                    int page = (currentFileIndex / perPage + (t.x < width * 0.3 ? pages - 1 : 1)) % pages;
+                    currentFileIndex = page * perPage;
                     drawHome();
-                } else if (t.y > (height * 2) / 3) {
-                    // Down or Power?
-                    // Bottom Right region for Power
-                    if (t.x > width * 0.6) {
-                        powerOffSequence();
-                    } else {
-                        // Down/Next File
-                        currentFileIndex++;
-                        if (currentFileIndex >= epubFiles.size()) currentFileIndex = 0;
-                        drawHome();
-                    }
+                }
+            } else if (t.wasPressed() && t.y >= 50) {
+                int index;
+                if (homeGrid) {
+                    int perPage = GRID_COLUMNS * GRID_ROWS;
+                    int row = (t.y - 50) / ((height - 50 - 50) / GRID_ROWS);
+                    int column = t.x / (width / GRID_COLUMNS);
+                    if (row >= GRID_ROWS) row = GRID_ROWS - 1;
+                    if (column >= GRID_COLUMNS) column = GRID_COLUMNS - 1;
+                    index = (currentFileIndex / perPage) * perPage + row * GRID_COLUMNS + column;
                 } else {
-
-
-                    // Select (Center)
-                    if (epubFiles.size() > 0) {
-                        targetOpenFile = "/" + epubFiles[currentFileIndex];
-                        startAsyncOp(OP_OPEN);
-                    }
+                    int rows = listRowsPerPage();
+                    int row = (t.y - 50) / LIST_ROW_HEIGHT;
+                    if (row >= rows) row = rows - 1;
+                    index = (currentFileIndex / rows) * rows + row;
+                }
+                xSemaphoreTake(libraryMutex, portMAX_DELAY);
+                bool exists = index < homeCount();
+                xSemaphoreGive(libraryMutex);
+                if (!exists) {
+                    // Past the last book
+                } else if (homeGrid || index == currentFileIndex) {
+                    // A cover, or the selected row, opens its book
+                    currentFileIndex = index;
+                    openSelectedBook();
+                } else {
+                    currentFileIndex = index;
+                    drawHome();
                 }
             }
+        } else if (libraryChanged) {
+            // libraryTask installed a new catalog or built covers
+            libraryChanged = false;
+            drawHome();
         }
     } 
     else if (currentState == STATE_READING) {
         if (textRedrawNeeded) {
             drawReader();
+        } else {
+            prerenderNeighbourPage();
         }
         
         if (M5.Touch.getCount() > 0) {
@@ -473,38 +1835,51 @@ void loop() {
                 if (t.x > width * 0.75) {
                     // NEXT PAGE
                     textScrollOffset++;
-                    if (textScrollOffset >= currentPages.size()) {
+                    if (!waitForPage(textScrollOffset)) {
                         // Next Chapter
-                         if (currentChapterIndex < reader.getChapters().size() - 1) {
-                            saveBookmark();
-                            targetLoadChapterIndex = currentChapterIndex + 1;
-                            startAsyncOp(OP_LOAD_CHAPTER);
+                         if (currentChapterIndex < chapterCount() - 1) {
+                            if (takePrefetchedChapter(currentChapterIndex + 1)) {
+                                textScrollOffset = 0;
+                                textRedrawNeeded = true;
+                                saveBookmark();
+                                requestBookmarkFlush();
+                                startPrefetch();
+                            } else {
+                                startAsyncOp(OP_LOAD_CHAPTER, currentChapterIndex + 1);
+                            }
                         } else {
                             textScrollOffset--; // End of book
                         }
                     } else {
                         textRedrawNeeded = true;
-                        if (textScrollOffset % 5 == 0) saveBookmark(); // Periodic save
+                        saveBookmark(); // RAM only; flushed later
                     }
                 } else if (t.x < width * 0.25) {
                     // PREV PAGE
                     textScrollOffset--;
                     if (textScrollOffset < 0) {
                         if (currentChapterIndex > 0) {
-                            saveBookmark();
-                            targetLoadChapterIndex = currentChapterIndex - 1;
-                             startAsyncOp(OP_LOAD_CHAPTER);
+                            if (takePrefetchedChapter(currentChapterIndex - 1)) {
+                                textScrollOffset = 0;
+                                textRedrawNeeded = true;
+                                saveBookmark();
+                                requestBookmarkFlush();
+                                startPrefetch();
+                            } else {
+                                startAsyncOp(OP_LOAD_CHAPTER, currentChapterIndex - 1);
+                            }
                         } else {
                             textScrollOffset = 0;
                         }
                     } else {
                          textRedrawNeeded = true;
-                         if (textScrollOffset % 5 == 0) saveBookmark();
+                         saveBookmark();
                     }
 
                 } else {
                     // CENTER -> OPEN MENU
                     currentState = STATE_MENU;
+                    openOverlay();
                     drawMenu();
                 }
             }
@@ -518,37 +1893,39 @@ void loop() {
                 int h = height / 3;
                 if (t.y > h) {
                     // Click outside -> Close Menu
-                    currentState = STATE_READING;
-                    textRedrawNeeded = true; // Redraw reader
+                    closeOverlay();
+                } else if (t.y > 130) {
+                    // Second row: cycle the full refresh cadence
+                    int next = 0;
+                    for (int i = 0; i < REFRESH_CHOICE_COUNT; i++) {
+                        if (REFRESH_CHOICES[i] == fullRefreshEvery) next = (i + 1) % REFRESH_CHOICE_COUNT;
+                    }
+                    fullRefreshEvery = REFRESH_CHOICES[next];
+                    turnsSinceFullRefresh = 0;
+                    saveSettings();
+                    beginOverlayUpdate();
+                    drawMenuSettingsRow();
+                    endOverlayUpdate();
                 } else {
                     // Inside Menu
                     // Left (Home)
                     if (t.x < width * 0.25) {
                         saveBookmark();
-                        reader.close();
-                        currentState = STATE_HOME;
-                        drawHome();
+                        requestBookmarkFlush();
+                        // The loader closes the book (behind the flush) and reports back for the home screen
+                        startAsyncOp(OP_CLOSE);
                     }
                     // Page Skip
                     else if (t.x < width * 0.5) {
                         currentState = STATE_SKIP_PAGE;
+                        skipTargetPage = currentGlobalPage();
+                        skipTargetPercent = -1;
                         drawSkipPage();
                     }
                     // Size
                     else if (t.x < width * 0.75) {
-                        // Toggle Size
-                        if (currentTextSize <= 3.0) currentTextSize = 4.0;
-                        else if (currentTextSize == 4.0) currentTextSize = 6.0;
-                        else currentTextSize = 3.0;
-                        
-                        // Repaginate
-                        M5.Display.fillScreen(COLOR_BG);
-                        M5.Display.drawCenterString("Resizing...", width/2, height/2, &fonts::FreeSansBold9pt7b);
-                        recalculatePages();
-                        saveBookmark();
-                        
-                        currentState = STATE_READING;
-                        textRedrawNeeded = true;
+                        // Re-laid out by the loader, keeping the current sentence on screen
+                        requestResize();
                     }
                     // Power Off
                     else {
@@ -565,12 +1942,69 @@ void loop() {
             auto t = M5.Touch.getDetail();
             if (t.wasPressed()) {
                 int h = height / 3;
-                if (t.y > h) {
-                    currentState = STATE_READING;
-                    textRedrawNeeded = true;
+                int chapter, page;
+                float fraction;
+                if (t.y > h && skipTargetPercent >= 0 && locatePercent(skipTargetPercent, chapter, fraction)) {
+                    if (chapter != currentChapterIndex) {
+                        // Only the target chapter is loaded; the page is found from its text
+                        startAsyncOp(OP_LOAD_CHAPTER, chapter, 0, fraction);
+                    } else {
+                        textScrollOffset = waitForOffset((int)(fraction * currentTextBuffer.length()));
+                        closeOverlay();
+                    }
+                } else if (t.y > h) {
+                    int sizeIndex = CompiledBook::sizeIndex(currentTextSize);
+                    xSemaphoreTake(pagesMutex, portMAX_DELAY);
+                    bool found = skipTargetPage >= 0 && bookIndex.locate(sizeIndex, skipTargetPage, chapter, page);
+                    xSemaphoreGive(pagesMutex);
+                    if (found && chapter != currentChapterIndex) {
+                        // Another chapter: load just that one, straight at the page
+                        startAsyncOp(OP_LOAD_CHAPTER, chapter, page);
+                    } else {
+                        if (found) textScrollOffset = waitForPage(page) ? page : laidOutPageCount() - 1;
+                        closeOverlay();
+                    }
+                } else if (t.y >= 150 && t.y < 210) {
+                    // Percent row: a target from the current position, jumped to on close
+                    if (skipTargetPercent < 0) {
+                        int offset = currentPageOffset();
+                        xSemaphoreTake(pagesMutex, portMAX_DELAY);
+                        skipTargetPercent = bookPercent(offset);
+                        xSemaphoreGive(pagesMutex);
+                    }
+                    if (t.x < width * 0.3) skipTargetPercent -= 10;
+                    else if (t.x < width * 0.5) skipTargetPercent -= 1;
+                    else if (t.x < width * 0.7) skipTargetPercent += 1;
+                    else skipTargetPercent += 10;
+                    if (skipTargetPercent < 0) skipTargetPercent = 0;
+                    if (skipTargetPercent > 99) skipTargetPercent = 99;
+                    
+                    beginOverlayUpdate();
+                    drawSkipPageNumber();
+                    endOverlayUpdate();
+                } else if (skipTargetPage >= 0) {
+                    // Book-wide: only the target moves until the panel is closed
+                    if (t.y > 100 && t.y < 150) {
+                        skipTargetPercent = -1;
+                        if (t.x < width * 0.3) skipTargetPage -= 10;
+                        else if (t.x < width * 0.5) skipTargetPage -= 1;
+                        else if (t.x < width * 0.7) skipTargetPage += 1;
+                        else skipTargetPage += 10;
+                        
+                        xSemaphoreTake(pagesMutex, portMAX_DELAY);
+                        int total = bookIndex.getTotalPages(CompiledBook::sizeIndex(currentTextSize));
+                        xSemaphoreGive(pagesMutex);
+                        if (skipTargetPage >= total) skipTargetPage = total - 1;
+                        if (skipTargetPage < 0) skipTargetPage = 0;
+                        
+                        beginOverlayUpdate();
+                        drawSkipPageNumber();
+                        endOverlayUpdate();
+                    }
                 } else {
                     // Inside skip menu
                     if (t.y > 100 && t.y < 150) {
+                        skipTargetPercent = -1;
                         if (t.x < width * 0.3) textScrollOffset -= 10;
                         else if (t.x < width * 0.5) textScrollOffset -= 1;
                         else if (t.x < width * 0.7) textScrollOffset += 1;
@@ -578,9 +2012,11 @@ void loop() {
                         
                         // Bounds check
                         if (textScrollOffset < 0) textScrollOffset = 0;
-                        if (textScrollOffset >= currentPages.size()) textScrollOffset = currentPages.size() - 1;
+                        if (!waitForPage(textScrollOffset)) textScrollOffset = laidOutPageCount() - 1;
                         
-                        drawSkipPage();
+                        beginOverlayUpdate();
+                        drawSkipPageNumber();
+                        endOverlayUpdate();
                     }
                 }
             }
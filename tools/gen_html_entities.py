@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Generates src/HTMLEntities.h from Python's HTML5 entity list.
+
+Usage: python3 tools/gen_html_entities.py > src/HTMLEntities.h
+"""
+import html.entities
+
+# Typographic code points the reader font has no glyph for, and what to show instead.
+# "" drops the character.
+FALLBACKS = {
+    0x00A0: " ",    # no-break space
+    0x00AD: "",     # soft hyphen
+    0x2002: " ", 0x2003: " ", 0x2004: " ", 0x2005: " ", 0x2006: " ",
+    0x2007: " ", 0x2008: " ", 0x2009: " ", 0x200A: " ",
+    0x200B: "", 0x200C: "", 0x200D: "",   # zero width space / (non-)joiner
+    0x2010: "-", 0x2011: "-", 0x2012: "-",
+    0x2013: "--",   # en dash
+    0x2014: "---",  # em dash
+    0x2015: "---",
+    0x2018: "'", 0x2019: "'", 0x201A: "'", 0x201B: "'",
+    0x201C: "\"", 0x201D: "\"", 0x201E: "\"", 0x201F: "\"",
+    0x2022: "*",
+    0x2026: "...",
+    0x202F: " ",
+    0x2032: "'", 0x2033: "\"",
+    0x2039: "<", 0x203A: ">",
+    0x2060: "",
+    0x2212: "-",
+    0xFB00: "ff", 0xFB01: "fi", 0xFB02: "fl", 0xFB03: "ffi", 0xFB04: "ffl",
+    0xFEFF: "",     # byte order mark
+}
+
+
+def c_string(s):
+    out = ""
+    for ch in s:
+        if ch in "\"\\":
+            out += "\\" + ch
+        else:
+            out += ch
+    return '"' + out + '"'
+
+
+def main():
+    entities = []
+    for name, value in html.entities.html5.items():
+        # Only the terminated forms; the tokenizer requires the ';'
+        if not name.endswith(";"):
+            continue
+        cps = [ord(c) for c in value]
+        assert len(cps) <= 2 and (len(cps) == 1 or cps[1] <= 0xFFFF)
+        entities.append((name[:-1], cps[0], cps[1] if len(cps) > 1 else 0))
+    entities.sort(key=lambda e: e[0].encode())
+    longest = max(len(e[0]) for e in entities)
+
+    print("// Generated by tools/gen_html_entities.py - do not edit.")
+    print("#ifndef HTML_ENTITIES_H")
+    print("#define HTML_ENTITIES_H")
+    print()
+    print("#include <stdint.h>")
+    print()
+    print("struct HTMLEntity {")
+    print("    const char* name;       // without '&' and ';'")
+    print("    uint32_t codepoint;")
+    print("    uint16_t codepoint2;    // second code point for the few two-character entities, else 0")
+    print("};")
+    print()
+    print("struct HTMLFallback {")
+    print("    uint32_t codepoint;")
+    print("    const char* text;       // ASCII replacement, empty to drop")
+    print("};")
+    print()
+    print("static const int HTML_ENTITY_MAX_NAME = %d;" % longest)
+    print("static const int HTML_ENTITY_COUNT = %d;" % len(entities))
+    print("static const int HTML_FALLBACK_COUNT = %d;" % len(FALLBACKS))
+    print()
+    print("// All HTML5 named character references, sorted by name (byte order)")
+    print("static constexpr HTMLEntity HTML_ENTITIES[HTML_ENTITY_COUNT] = {")
+    for name, cp, cp2 in entities:
+        print("    { %s, 0x%X, 0x%X }," % (c_string(name), cp, cp2))
+    print("};")
+    print()
+    # HTML5 reads numeric references in 0x80-0x9F as Windows-1252 (&#151; is an em dash)
+    c1 = []
+    for b in range(0x80, 0xA0):
+        try:
+            c1.append(ord(bytes([b]).decode("cp1252")))
+        except UnicodeDecodeError:
+            c1.append(b)
+    print("// Numeric references &#128; to &#159;, decoded as Windows-1252")
+    print("static constexpr uint16_t HTML_CP1252_C1[32] = {")
+    for i in range(0, 32, 8):
+        print("    " + ", ".join("0x%04X" % cp for cp in c1[i:i + 8]) + ",")
+    print("};")
+    print()
+    print("// Sorted by code point")
+    print("static constexpr HTMLFallback HTML_FALLBACKS[HTML_FALLBACK_COUNT] = {")
+    for cp in sorted(FALLBACKS):
+        print("    { 0x%04X, %s }," % (cp, c_string(FALLBACKS[cp])))
+    print("};")
+    print()
+    print("#endif")
+
+
+if __name__ == "__main__":
+    main()
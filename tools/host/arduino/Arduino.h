@@ -0,0 +1,232 @@
+// Host stand-in for the parts of the Arduino core the reader's book code uses,
+// so EpubReader, ZipIndex, BlockCache and LibraryCatalog build on a PC for
+// the benchmarks in tools/host. Not a general Arduino emulation.
+#pragma once
+#include <string>
+#include <strings.h>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdarg>
+#include <cctype>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+// Follows the ESP32 core's WString where it matters for the benchmarks:
+// strings up to 10 chars live inline, longer ones grow with an exact
+// realloc on every reserve() or concat() past the capacity.
+class String {
+public:
+    String() {}
+    String(const char* c) { if (c) copy(c, strlen(c)); }
+    String(const std::string& x) { copy(x.data(), x.size()); }
+    String(const String& o) { copy(o.c_str(), o.len); }
+    String(String&& o) noexcept { move(o); }
+    explicit String(char c) { copy(&c, 1); }
+    String(int v) { fromNumber("%d", v); }
+    String(unsigned v) { fromNumber("%u", v); }
+    String(long v) { fromNumber("%ld", v); }
+    String(unsigned long v) { fromNumber("%lu", v); }
+    ~String() { if (heap) free(heap); }
+
+    String& operator=(const String& o) { if (this != &o) { len = 0; copy(o.c_str(), o.len); } return *this; }
+    String& operator=(String&& o) noexcept { if (this != &o) { if (heap) free(heap); heap = nullptr; move(o); } return *this; }
+    String& operator=(const char* c) { len = 0; copy(c ? c : "", c ? strlen(c) : 0); return *this; }
+
+    unsigned int length() const { return len; }
+    const char* c_str() const { return heap ? heap : sso; }
+    char operator[](unsigned i) const { return i < len ? c_str()[i] : 0; }
+    char& operator[](unsigned i) { return buffer()[i]; }
+    bool reserve(unsigned size) {
+        if (size <= cap) return true;
+        if (size < sizeof(sso)) return true;
+        char* grown = (char*)realloc(heap, size + 1);
+        if (!grown) return false;
+        if (!heap) memcpy(grown, sso, len + 1);
+        heap = grown;
+        cap = size;
+        return true;
+    }
+
+    String substring(unsigned from) const { return substring(from, len); }
+    String substring(unsigned from, unsigned to) const {
+        if (to > len) to = len;
+        String r;
+        if (from < to) r.copy(c_str() + from, to - from);
+        return r;
+    }
+    int indexOf(char c, unsigned from = 0) const {
+        const char* p = from < len ? (const char*)memchr(c_str() + from, c, len - from) : nullptr;
+        return p ? (int)(p - c_str()) : -1;
+    }
+    int indexOf(const char* x, unsigned from = 0) const {
+        const char* p = from <= len ? strstr(c_str() + from, x) : nullptr;
+        return p ? (int)(p - c_str()) : -1;
+    }
+    int indexOf(const String& x, unsigned from = 0) const { return indexOf(x.c_str(), from); }
+    int lastIndexOf(char c) const { const char* p = strrchr(c_str(), c); return p ? (int)(p - c_str()) : -1; }
+    int lastIndexOf(const char* x) const {
+        int found = -1;
+        for (int p = indexOf(x); p >= 0; p = indexOf(x, p + 1)) found = p;
+        return found;
+    }
+    bool startsWith(const String& p) const { return p.len <= len && memcmp(c_str(), p.c_str(), p.len) == 0; }
+    bool endsWith(const String& p) const { return p.len <= len && memcmp(c_str() + len - p.len, p.c_str(), p.len) == 0; }
+    bool equals(const String& o) const { return *this == o; }
+    bool equalsIgnoreCase(const String& o) const { return o.len == len && strncasecmp(c_str(), o.c_str(), len) == 0; }
+
+    void replace(char from, char to) { for (unsigned i = 0; i < len; i++) if (buffer()[i] == from) buffer()[i] = to; }
+    void replace(const String& from, const String& to) {
+        // Like WString: in place, with one exact realloc when the text grows
+        if (from.len == 0) return;
+        int hits = 0;
+        for (int p = indexOf(from); p >= 0; p = indexOf(from, p + from.len)) hits++;
+        if (hits == 0) return;
+        unsigned newLen = to.len > from.len ? len + hits * (to.len - from.len) : len;
+        if (!reserve(newLen)) return;
+        // Growing: move the text to the end first so writing never passes reading
+        char* buf = buffer();
+        unsigned shift = newLen - len;
+        memmove(buf + shift, buf, len + 1);
+        char* w = buf;
+        const char* r = buf + shift;
+        for (const char* hit; (hit = strstr(r, from.c_str())) != nullptr; r = hit + from.len) {
+            memmove(w, r, hit - r);
+            w += hit - r;
+            memcpy(w, to.c_str(), to.len);
+            w += to.len;
+        }
+        size_t tail = strlen(r);
+        memmove(w, r, tail + 1);
+        len = (w - buf) + tail;
+    }
+    void remove(unsigned index) { remove(index, len); }
+    void remove(unsigned index, unsigned count) {
+        if (index >= len) return;
+        if (count > len - index) count = len - index;
+        memmove(buffer() + index, buffer() + index + count, len - index - count + 1);
+        len -= count;
+    }
+    void trim() {
+        unsigned a = 0, b = len;
+        while (a < b && isspace((unsigned char)c_str()[a])) a++;
+        while (b > a && isspace((unsigned char)c_str()[b - 1])) b--;
+        memmove(buffer(), c_str() + a, b - a);
+        len = b - a;
+        buffer()[len] = '\0';
+    }
+    void toLowerCase() { for (unsigned i = 0; i < len; i++) buffer()[i] = tolower((unsigned char)buffer()[i]); }
+    long toInt() const { return atol(c_str()); }
+    float toFloat() const { return atof(c_str()); }
+
+    bool concat(const char* c, unsigned n) {
+        if (!reserve(len + n)) return false;
+        memmove(buffer() + len, c, n);
+        len += n;
+        buffer()[len] = '\0';
+        return true;
+    }
+    bool concat(const char* c) { return concat(c, strlen(c)); }
+    bool concat(const String& o) { return concat(o.c_str(), o.len); }
+    bool concat(char c) { return concat(&c, 1); }
+    bool concat(int v) { return concat(String(v)); }
+    bool concat(unsigned v) { return concat(String(v)); }
+    bool concat(long v) { return concat(String(v)); }
+    bool concat(unsigned long v) { return concat(String(v)); }
+    template<class T> String& operator+=(const T& v) { concat(v); return *this; }
+
+    bool operator==(const String& o) const { return len == o.len && memcmp(c_str(), o.c_str(), len) == 0; }
+    bool operator==(const char* o) const { return strcmp(c_str(), o) == 0; }
+    bool operator!=(const String& o) const { return !(*this == o); }
+    bool operator!=(const char* o) const { return !(*this == o); }
+    bool operator<(const String& o) const { return strcmp(c_str(), o.c_str()) < 0; }
+
+private:
+    char sso[11] = {};        // 10 chars + NUL inline, as on the ESP32
+    char* heap = nullptr;
+    unsigned cap = sizeof(sso) - 1;
+    unsigned len = 0;
+
+    char* buffer() { return heap ? heap : sso; }
+    void copy(const char* c, unsigned n) {
+        if (!reserve(n)) return;
+        memmove(buffer(), c, n);
+        len = n;
+        buffer()[len] = '\0';
+    }
+    void move(String& o) {
+        memcpy(sso, o.sso, sizeof(sso));
+        heap = o.heap;
+        cap = o.cap;
+        len = o.len;
+        o.heap = nullptr;
+        o.cap = sizeof(o.sso) - 1;
+        o.len = 0;
+        o.sso[0] = '\0';
+    }
+    template<class T> void fromNumber(const char* format, T v) {
+        char buf[24];
+        snprintf(buf, sizeof(buf), format, v);
+        copy(buf, strlen(buf));
+    }
+};
+
+inline String operator+(const String& a, const String& b) { String r(a); r.concat(b); return r; }
+inline String operator+(const String& a, const char* b) { String r(a); r.concat(b); return r; }
+inline String operator+(const char* a, const String& b) { String r(a); r.concat(b); return r; }
+inline String operator+(const String& a, char b) { String r(a); r.concat(b); return r; }
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        for (size_t i = 0; i < size; i++) write(buffer[i]);
+        return size;
+    }
+    size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+    size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+    size_t println(const String& s = String()) { return print(s) + print("\n"); }
+    size_t println(const char* s) { return print(s) + print("\n"); }
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char buf[512];
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+        if (n < 0) return 0;
+        return write((const uint8_t*)buf, std::min<size_t>(n, sizeof(buf) - 1));
+    }
+};
+
+// Serial goes to stderr so benchmark results on stdout stay clean; set
+// quiet to drop the reader's own logging entirely
+class HostSerial : public Print {
+public:
+    bool quiet = false;
+    void begin(unsigned long) {}
+    size_t write(uint8_t c) override { if (!quiet) fputc(c, stderr); return 1; }
+    using Print::write;
+};
+extern HostSerial Serial;
+
+inline unsigned long millis() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+inline unsigned long micros() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+inline void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+inline void yield() {}
+
+// One heap on the host; PSRAM requests are plain mallocs
+#define MALLOC_CAP_SPIRAM 1
+#define MALLOC_CAP_8BIT 2
+#define MALLOC_CAP_INTERNAL 4
+inline void* heap_caps_malloc(size_t size, uint32_t) { return malloc(size); }
+inline void* heap_caps_calloc(size_t n, size_t size, uint32_t) { return calloc(n, size); }
+inline void* heap_caps_realloc(void* p, size_t size, uint32_t) { return realloc(p, size); }
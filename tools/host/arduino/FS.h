@@ -0,0 +1,106 @@
+// Host stand-in for the Arduino FS API over a directory of the PC's file
+// system (hostFsRoot plays the LittleFS partition)
+#pragma once
+#include "Arduino.h"
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+
+extern std::string hostFsRoot;
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File : public Print {
+public:
+    File() {}
+    File(FILE* f, const std::string& fullPath) : fp(f), path(fullPath) {}
+    File(DIR* d, const std::string& fullPath) : dir(d), path(fullPath) {}
+
+    explicit operator bool() const { return fp || dir; }
+    size_t size() {
+        struct stat st;
+        return fp && fstat(fileno(fp), &st) == 0 ? st.st_size : 0;
+    }
+    size_t read(uint8_t* buf, size_t size) { return fp ? fread(buf, 1, size, fp) : 0; }
+    int read() { return fp ? fgetc(fp) : -1; }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t size) override { return fp ? fwrite(buf, 1, size, fp) : 0; }
+    using Print::write;
+    bool seek(uint32_t pos, SeekMode mode = SeekSet) { return fp && fseek(fp, pos, mode) == 0; }
+    size_t position() { return fp ? ftell(fp) : 0; }
+    int available() { return fp ? (int)(size() - position()) : 0; }
+    void flush() { if (fp) fflush(fp); }
+    void close() {
+        if (fp) fclose(fp);
+        if (dir) closedir(dir);
+        fp = nullptr;
+        dir = nullptr;
+    }
+    const char* name() const {
+        size_t slash = path.rfind('/');
+        return path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+    }
+    bool isDirectory() const { return dir != nullptr; }
+    time_t getLastWrite() {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 ? st.st_mtime : 0;
+    }
+    File openNextFile() {
+        while (dir) {
+            dirent* e = readdir(dir);
+            if (!e) break;
+            if (e->d_name[0] == '.') continue;
+            std::string child = path + "/" + e->d_name;
+            struct stat st;
+            if (stat(child.c_str(), &st) != 0) continue;
+            if (S_ISDIR(st.st_mode)) return File(opendir(child.c_str()), child);
+            return File(fopen(child.c_str(), "rb"), child);
+        }
+        return File();
+    }
+
+private:
+    FILE* fp = nullptr;
+    DIR* dir = nullptr;
+    std::string path;
+};
+
+class FS {
+public:
+    bool begin(bool formatOnFail = false) { return true; }
+    File open(const String& path, const char* mode = "r", bool create = false) {
+        std::string full = fullPath(path);
+        struct stat st;
+        if (stat(full.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) return File(opendir(full.c_str()), full);
+        std::string m = mode;
+        if (m == "r") m = "rb";
+        else if (m == "w") m = "wb";
+        else if (m == "a") m = "ab";
+        else if (m == "r+") m = "r+b";
+        FILE* f = fopen(full.c_str(), m.c_str());
+        return f ? File(f, full) : File();
+    }
+    File open(const char* path, const char* mode = "r", bool create = false) { return open(String(path), mode, create); }
+    bool exists(const String& path) {
+        struct stat st;
+        return stat(fullPath(path).c_str(), &st) == 0;
+    }
+    bool remove(const String& path) { return ::unlink(fullPath(path).c_str()) == 0; }
+    bool rename(const String& from, const String& to) { return ::rename(fullPath(from).c_str(), fullPath(to).c_str()) == 0; }
+    bool mkdir(const String& path) { return ::mkdir(fullPath(path).c_str(), 0755) == 0; }
+    bool rmdir(const String& path) { return ::rmdir(fullPath(path).c_str()) == 0; }
+
+private:
+    static std::string fullPath(const String& path) {
+        std::string p = path.c_str();
+        if (p.empty() || p[0] != '/') p = "/" + p;
+        return hostFsRoot + p;
+    }
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
@@ -0,0 +1,5 @@
+#pragma once
+#include "FS.h"
+
+class LittleFSFS : public fs::FS {};
+extern LittleFSFS LittleFS;
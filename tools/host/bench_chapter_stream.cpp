@@ -0,0 +1,48 @@
+// Peak heap and throughput of EpubReader::getChapterContent (inflate streamed
+// into the tag stripper) over every chapter of the bundled books.
+#include <Arduino.h>
+#include "EpubReader.h"
+#include "host_heap.h"
+
+int main(int argc, char** argv) {
+    hostFsRoot = argv[1];
+    Serial.quiet = true;
+
+    for (const char* book : { "/Dune.epub", "/pg26150.epub" }) {
+        EpubReader reader;
+        if (!reader.open(book)) {
+            printf("%s: open failed\n", book);
+            return 1;
+        }
+
+        size_t rawTotal = 0, textTotal = 0;
+        unsigned long totalUs = 0;
+        size_t worstPeak = 0, worstRaw = 0, worstText = 0;
+        int worstChapter = -1;
+        for (size_t i = 0; i < reader.getChapters().size(); i++) {
+            size_t base = hostHeap::inUse();
+            hostHeap::resetPeak();
+            unsigned long startUs = micros();
+            String text = reader.getChapterContent(i);
+            totalUs += micros() - startUs;
+            size_t peak = hostHeap::peak() - base;
+
+            size_t raw = reader.getChapters()[i].size;
+            rawTotal += raw;
+            textTotal += text.length();
+            if (peak > worstPeak) {
+                worstPeak = peak;
+                worstRaw = raw;
+                worstText = text.length();
+                worstChapter = i;
+            }
+        }
+
+        printf("%s: %zu chapters, %zu KB XHTML -> %zu KB text, %.1f MB/s\n", book, reader.getChapters().size(),
+               rawTotal / 1024, textTotal / 1024, totalUs ? rawTotal / (double)totalUs : 0.0);
+        printf("  peak heap %zu KB in chapter %d (%zu KB XHTML, %zu KB text)\n", worstPeak / 1024, worstChapter,
+               worstRaw / 1024, worstText / 1024);
+        reader.close();
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+// LibraryCatalog on a generated library (gen_library.py): cost of open(),
+// of a first and an unchanged update(), of one changed and one removed book,
+// and of reading a home screen of rows in either sort order.
+#include <Arduino.h>
+#include <utime.h>
+#include "LibraryCatalog.h"
+#include "host_heap.h"
+
+const int SCREEN_ROWS = 13;
+
+void pass(const char* label) {
+    LibraryCatalog catalog;
+    size_t base = hostHeap::inUse();
+    unsigned long startUs = micros();
+    catalog.open("/library.hlc");
+    unsigned long openUs = micros() - startUs;
+    size_t openHeap = hostHeap::inUse() - base;
+
+    hostHeap::resetPeak();
+    startUs = micros();
+    int scanned = catalog.update("/");
+    bool installed = scanned >= 0 && catalog.install();
+    unsigned long updateUs = micros() - startUs;
+    size_t updatePeak = hostHeap::peak() - base;
+
+    printf("%s: %d books\n", label, catalog.getCount());
+    printf("  open %lu us, %zu B heap\n", openUs, openHeap);
+    printf("  update %lu ms, %d books opened%s, peak heap %zu KB\n", updateUs / 1000, scanned < 0 ? 0 : scanned,
+           installed ? "" : " (nothing to install)", updatePeak / 1024);
+
+    int first = catalog.getCount() / 2;
+    for (int order = 0; order < LibraryCatalog::SORT_ORDER_COUNT; order++) {
+        LibraryCatalog::Entry entry;
+        hostHeap::resetPeak();
+        size_t before = hostHeap::inUse();
+        startUs = micros();
+        for (int p = first; p < first + SCREEN_ROWS; p++) catalog.readSorted((LibraryCatalog::SortOrder)order, p, entry);
+        printf("  %d rows by %s in %lu us, %zu B heap\n", SCREEN_ROWS, order == LibraryCatalog::SORT_TITLE ? "title" : "author",
+               micros() - startUs, hostHeap::peak() - before);
+    }
+
+    LibraryCatalog::Entry entry;
+    catalog.read(first, entry);
+    startUs = micros();
+    int found = catalog.findById(entry.bookId);
+    printf("  findById %s in %lu us%s\n", entry.name, micros() - startUs, found == first ? "" : " (wrong record)");
+}
+
+int main(int argc, char** argv) {
+    hostFsRoot = argv[1];
+    Serial.quiet = true;
+
+    pass("first update");
+    pass("unchanged");
+    // mtime has one second resolution
+    delay(1100);
+    utime((hostFsRoot + "/book0042.epub").c_str(), nullptr);
+    LittleFS.remove("/book0043.epub");
+    pass("one changed, one removed");
+    return 0;
+}
@@ -0,0 +1,64 @@
+// HTMLStripper (one linear pass) against the old substring/replace based
+// stripTags: throughput and heap allocations over every chapter's raw XHTML.
+#include <Arduino.h>
+#include "EpubReader.h"
+#include "HTMLParser.h"
+#include "host_heap.h"
+#include "legacy_strip_tags.h"
+
+struct Result {
+    unsigned long us = 0;
+    unsigned long allocations = 0;
+    size_t textBytes = 0;
+};
+
+template<class Strip> void measure(const String& raw, Result& result, Strip strip) {
+    unsigned long allocations = hostHeap::allocations();
+    unsigned long startUs = micros();
+    String text = strip(raw);
+    result.us += micros() - startUs;
+    result.allocations += hostHeap::allocations() - allocations;
+    result.textBytes += text.length();
+}
+
+int main(int argc, char** argv) {
+    hostFsRoot = argv[1];
+    Serial.quiet = true;
+
+    for (const char* book : { "/Dune.epub", "/pg26150.epub" }) {
+        EpubReader reader;
+        mz_zip_archive zip;
+        memset(&zip, 0, sizeof(zip));
+        if (!reader.open(book) || !mz_zip_reader_init_file(&zip, (hostFsRoot + book).c_str(), 0)) {
+            printf("%s: open failed\n", book);
+            return 1;
+        }
+
+        size_t rawBytes = 0;
+        int differing = 0;
+        Result before, after;
+        for (const EpubChapter& chapter : reader.getChapters()) {
+            // The raw XHTML, so both sides time only the stripping
+            size_t size = 0;
+            char* data = (char*)mz_zip_reader_extract_file_to_heap(&zip, chapter.filename.c_str(), &size, 0);
+            if (!data) continue;
+            String raw;
+            raw.concat(data, size);
+            mz_free(data);
+            rawBytes += size;
+
+            measure(raw, before, legacy::stripTags);
+            measure(raw, after, HTMLParser::stripTags);
+            if (!(legacy::stripTags(raw) == HTMLParser::stripTags(raw))) differing++;
+        }
+        mz_zip_reader_end(&zip);
+
+        printf("%s: %zu chapters, %zu KB XHTML, %d with different text\n", book, reader.getChapters().size(),
+               rawBytes / 1024, differing);
+        printf("  old stripTags:  %6.1f MB/s, %7lu allocations, %zu KB text\n",
+               before.us ? rawBytes / (double)before.us : 0.0, before.allocations, before.textBytes / 1024);
+        printf("  HTMLStripper:   %6.1f MB/s, %7lu allocations, %zu KB text\n",
+               after.us ? rawBytes / (double)after.us : 0.0, after.allocations, after.textBytes / 1024);
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+#!/usr/bin/env python3
+# Writes count small synthetic EPUBs into dir for the library benchmark:
+# random titles, a tenth without an author, one short chapter each.
+#
+# Usage: gen_library.py <dir> <count>
+import os
+import random
+import sys
+import zipfile
+
+CONTAINER = ('<?xml version="1.0"?><container version="1.0" '
+             'xmlns="urn:oasis:names:tc:opendocument:xmlns:container"><rootfiles>'
+             '<rootfile full-path="OEBPS/content.opf" media-type="application/oebps-package+xml"/>'
+             '</rootfiles></container>')
+
+WORDS = "river night glass empire salt winter orchard signal harbor ember atlas quiet hollow crown ledger".split()
+FIRST = "Ada Boris Clara Dmitri Elena Farid Greta Hiro Ines Jonas Kenji Lena Mateo Nora Omar".split()
+LAST = "Abbott Brandt Castillo Dvorak Eklund Fischer Grimaldi Haddad Ito Jansen Kowalski Larsen Moreau Novak Okafor".split()
+
+
+def opf(i, title, author):
+    creator = f"<dc:creator>{author}</dc:creator>" if author else ""
+    return ('<?xml version="1.0"?><package xmlns="http://www.idpf.org/2007/opf" version="3.0">'
+            '<metadata xmlns:dc="http://purl.org/dc/elements/1.1/">'
+            f'<dc:title>{title}</dc:title>{creator}<dc:language>en</dc:language><dc:identifier>id{i}</dc:identifier>'
+            '</metadata><manifest><item id="c1" href="c1.xhtml" media-type="application/xhtml+xml"/></manifest>'
+            '<spine><itemref idref="c1"/></spine></package>')
+
+
+def main():
+    out, count = sys.argv[1], int(sys.argv[2])
+    os.makedirs(out, exist_ok=True)
+    random.seed(7)
+    for i in range(count):
+        title = " ".join(random.choice(WORDS).capitalize() for _ in range(random.randint(1, 4)))
+        author = f"{random.choice(FIRST)} {random.choice(LAST)}" if i % 10 else ""
+        with zipfile.ZipFile(os.path.join(out, f"book{i:04d}.epub"), "w") as z:
+            z.writestr("mimetype", "application/epub+zip")
+            z.writestr("META-INF/container.xml", CONTAINER)
+            z.writestr("OEBPS/content.opf", opf(i, title, author))
+            z.writestr("OEBPS/c1.xhtml", f"<html><body><p>Book {i}</p></body></html>")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,85 @@
+// Globals of the Arduino stand-ins, and the heap accounting behind host_heap.h
+#include "Arduino.h"
+#include "LittleFS.h"
+#include "host_heap.h"
+#include <atomic>
+#include <new>
+#include <malloc.h>
+
+HostSerial Serial;
+LittleFSFS LittleFS;
+std::string hostFsRoot = ".";
+
+extern "C" {
+    void* __real_malloc(size_t size);
+    void* __real_calloc(size_t n, size_t size);
+    void* __real_realloc(void* p, size_t size);
+    void __real_free(void* p);
+}
+
+namespace {
+    std::atomic<size_t> heapInUse(0);
+    std::atomic<size_t> heapPeak(0);
+    std::atomic<unsigned long> heapAllocations(0);
+
+    void raisePeak(size_t bytes) {
+        size_t peak = heapPeak;
+        while (bytes > peak && !heapPeak.compare_exchange_weak(peak, bytes)) {}
+    }
+
+    void track(void* p) {
+        if (!p) return;
+        heapAllocations++;
+        raisePeak(heapInUse += malloc_usable_size(p));
+    }
+
+    void untrack(void* p) {
+        if (p) heapInUse -= malloc_usable_size(p);
+    }
+}
+
+extern "C" {
+    void* __wrap_malloc(size_t size) {
+        void* p = __real_malloc(size);
+        track(p);
+        return p;
+    }
+    void* __wrap_calloc(size_t n, size_t size) {
+        void* p = __real_calloc(n, size);
+        track(p);
+        return p;
+    }
+    void* __wrap_realloc(void* p, size_t size) {
+        size_t before = heapInUse;
+        size_t oldSize = p ? malloc_usable_size(p) : 0;
+        void* q = __real_realloc(p, size);
+        if (!q && size > 0) return q; // failed; p is untouched
+        heapInUse -= oldSize;
+        track(q);
+        // A moving realloc holds the old and the new block for a moment
+        if (p && q && q != p) raisePeak(before + malloc_usable_size(q));
+        return q;
+    }
+    void __wrap_free(void* p) {
+        untrack(p);
+        __real_free(p);
+    }
+}
+
+void* operator new(size_t size) {
+    void* p = __wrap_malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { __wrap_free(p); }
+void operator delete[](void* p) noexcept { __wrap_free(p); }
+void operator delete(void* p, size_t) noexcept { __wrap_free(p); }
+void operator delete[](void* p, size_t) noexcept { __wrap_free(p); }
+
+namespace hostHeap {
+    size_t inUse() { return heapInUse; }
+    size_t peak() { return heapPeak; }
+    void resetPeak() { heapPeak = (size_t)heapInUse; }
+    unsigned long allocations() { return heapAllocations; }
+}
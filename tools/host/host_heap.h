@@ -0,0 +1,12 @@
+// Heap accounting for the host benchmarks. run.sh links every benchmark with
+// malloc/calloc/realloc/free wrapped (and operator new/delete routed through
+// them), so this sees the reader's own buffers, miniz and every String.
+#pragma once
+#include <cstddef>
+
+namespace hostHeap {
+    size_t inUse();              // bytes currently allocated
+    size_t peak();               // high-water mark since the last resetPeak()
+    void resetPeak();
+    unsigned long allocations(); // malloc/calloc/realloc calls so far
+}
@@ -0,0 +1,46 @@
+#!/bin/bash
+# Builds and runs one of the host benchmarks against the reader's own sources.
+#
+# Usage: tools/host/run.sh <benchmark>
+#
+#   chapter_stream  peak heap and MB/s of getChapterContent on data/*.epub
+#   stripper        HTMLStripper vs the old stripTags: MB/s and allocations
+#   library         LibraryCatalog on a generated 5,000-book directory
+#
+# Needs g++, gcc and python3. tinyxml2 comes from PlatformIO's checkout
+# (run `pio run` once) or from TINYXML2_DIR.
+set -e
+
+bench=$1
+root=$(cd "$(dirname "$0")/../.." && pwd)
+host="$root/tools/host"
+if [ ! -f "$host/bench_$bench.cpp" ]; then
+    awk 'NR > 1 && /^#/ { sub(/^# ?/, ""); print; next } NR > 1 { exit }' "$0"
+    exit 1
+fi
+
+tinyxml=${TINYXML2_DIR:-$root/.pio/libdeps/m5papers3_display/tinyxml2}
+if [ ! -f "$tinyxml/tinyxml2.cpp" ]; then
+    echo "tinyxml2 not found in $tinyxml; run 'pio run' once or set TINYXML2_DIR" >&2
+    exit 1
+fi
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+mkdir "$work/fs"
+
+gcc -O2 -w -c "$root/lib/miniz/miniz.c" -I"$root/lib/miniz" -o "$work/miniz.o"
+g++ -std=gnu++17 -O2 -w \
+    -I"$host/arduino" -I"$host" -I"$root/src" -I"$root/lib/miniz" -I"$tinyxml" \
+    "$host/bench_$bench.cpp" "$host/host.cpp" \
+    "$root/src/EpubReader.cpp" "$root/src/ZipIndex.cpp" "$root/src/BlockCache.cpp" \
+    "$root/src/LibraryCatalog.cpp" "$tinyxml/tinyxml2.cpp" "$work/miniz.o" \
+    -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free -lpthread \
+    -o "$work/bench"
+
+# The benchmarks run on a scratch copy: opening a book writes sidecars next to it
+case $bench in
+    library) python3 "$host/gen_library.py" "$work/fs" 5000 ;;
+    *) cp "$root"/data/*.epub "$work/fs/" ;;
+esac
+"$work/bench" "$work/fs"